@@ -0,0 +1,307 @@
+// Host microbenchmarks for the sensor path of loop(), built by [env:native].
+//
+//   pio run -e native && .pio/build/native/program [filter] [-n iterations] [--csv]
+//
+// Each case runs against the virtual clock of the Arduino shim: every
+// iteration advances time by LOOP_PERIOD_US, and a synthetic corridor
+// (someone in range for 2 s every 10 s) drives the sensor pins. Reported
+// times are host CPU time per iteration, only meaningful relative to
+// another run on the same machine.
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <Arduino.h>
+
+#include "bouton.hpp"
+#include "capteur.hpp"
+#include "catalogue.hpp"
+#include "groupe.hpp"
+#include "horloge.hpp"
+#include "infrarouge.hpp"
+#include "loop_model.hpp"
+#include "metrics.hpp"
+#include "pir.hpp"
+#include "scheduler.hpp"
+#include "stall.hpp"
+#include "timer.hpp"
+#include "ultrason.hpp"
+
+namespace {
+
+constexpr uint32_t LOOP_PERIOD_US = 1000;
+constexpr uint32_t PRESENCE_PERIOD_MS = 10000;
+constexpr uint32_t PRESENCE_DURATION_MS = 2000;
+constexpr uint32_t ECHO_NEAR_US = 290;   // ~5 cm
+constexpr uint32_t ECHO_FAR_US = 5800;   // ~1 m
+
+constexpr uint8_t SENSOR_PIN = D0;
+constexpr uint8_t TRIG_PIN = D3;
+// Interrupt-capable pins, D0 only gets the polling/pulseIn() fallbacks
+constexpr uint8_t IRQ_PIN = D5;
+constexpr uint8_t ECHO_IRQ_PIN = D6;
+
+bool presence(uint64_t now_us) {
+    return (now_us / 1000) % PRESENCE_PERIOD_MS < PRESENCE_DURATION_MS;
+}
+
+void corridorHook(uint64_t now_us) {
+    bool someone = presence(now_us);
+    shim::setPin(SENSOR_PIN, someone ? HIGH : LOW);
+    shim::setPin(IRQ_PIN, someone ? HIGH : LOW);
+    shim::setPulse(SENSOR_PIN, someone ? ECHO_NEAR_US : ECHO_FAR_US);
+    shim::setPulse(ECHO_IRQ_PIN, someone ? ECHO_NEAR_US : ECHO_FAR_US);
+}
+
+struct BenchCase
+{
+    std::string name;
+    std::function<Capteur*()> make;
+};
+
+struct BenchResult
+{
+    uint32_t iterations;
+    double ns_per_iter;
+    uint32_t events;
+    double virtual_seconds;
+};
+
+BenchResult runLoop(const BenchCase& bench, uint32_t iterations) {
+    shim::reset();
+    shim::setInputHook(corridorHook);
+    shim::linkEcho(TRIG_PIN, ECHO_IRQ_PIN);
+
+    LoopModel model(bench.make());
+    model.capteur->setMaxSound(5);
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; i++) {
+        model.iteration();
+        shim::advanceMicros(LOOP_PERIOD_US);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    return {iterations, std::chrono::duration<double, std::nano>(elapsed).count() / iterations,
+            (uint32_t)model.trigger_ms.size(), shim::nowMicros() / 1e6};
+}
+
+void countMinute(void* ctx) {
+    (*static_cast<uint32_t*>(ctx))++;
+}
+
+// Clock and timer wheel as loop() drives them: a minute timer like the
+// housekeeping one, plus a few one-shot deadlines kept in the future.
+BenchResult runTick(uint32_t iterations) {
+    shim::reset();
+    Horloge horloge;
+    TimerWheel timers;
+    uint32_t minutes = 0;
+    Timer minute(countMinute, &minutes, 60000);
+    Timer pending[4] = {Timer(countMinute, nullptr), Timer(countMinute, nullptr),
+                        Timer(countMinute, nullptr), Timer(countMinute, nullptr)};
+    timers.schedule(minute, 60000);
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; i++) {
+        timers.advance(horloge.tick(millis()));
+        timers.schedule(pending[i % 4], 10000 + i % 4 * 1000);
+        shim::advanceMicros(LOOP_PERIOD_US);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    return {iterations, std::chrono::duration<double, std::nano>(elapsed).count() / iterations, minutes,
+            shim::nowMicros() / 1e6};
+}
+
+void countRun(void* ctx) {
+    (*static_cast<uint32_t*>(ctx))++;
+}
+
+// Scheduler pass with the task mix of main.cpp: two tasks every pass, the
+// critical one between the others, and periodic ones mostly asleep. The
+// every-pass ones feed duration histograms like the /metrics ones, and
+// every phase is timed by the stall detector.
+BenchResult runScheduler(uint32_t iterations) {
+    shim::reset();
+    Horloge horloge;
+    TimerWheel timers;
+    Scheduler scheduler(timers);
+    uint32_t pumps = 0, others = 0;
+    Task pump("pump", countRun, SCHEDULER_CRITICAL, 0, &pumps);
+    Task capteur("capteur", countRun, 1, 0, &others);
+    Task sync("sync", countRun, 2, 0, &others);
+    Task http("http", countRun, 4, 10, &others);
+    Task ntp("ntp", countRun, 5, 60000, &others);
+    Task log("log", countRun, 6, 60000, &others);
+    for (Task* task : {&pump, &capteur, &sync, &http, &ntp, &log}) {
+        scheduler.add(*task);
+    }
+    constexpr uint32_t bounds[] = {50, 100, 200, 500, 1000, 2000, 5000, 10000, 20000, 50000, 100000};
+    Histogram pump_duration("pump", "", bounds, 11), capteur_duration("capteur", "", bounds, 11),
+        sync_duration("sync", "", bounds, 11);
+    pump.duration = &pump_duration;
+    capteur.duration = &capteur_duration;
+    sync.duration = &sync_duration;
+    StallDetector stalls;
+    stalls.begin(nullptr);
+    scheduler.watch(stalls);
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; i++) {
+        stalls.beginIteration();
+        stalls.enter(STALL_PHASE_TIMERS);
+        timers.advance(horloge.tick(millis()));
+        stalls.exit();
+        scheduler.run();
+        stalls.endIteration();
+        shim::advanceMicros(LOOP_PERIOD_US);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    return {iterations, std::chrono::duration<double, std::nano>(elapsed).count() / iterations, pumps,
+            shim::nowMicros() / 1e6};
+}
+
+BenchResult runPickMusic(uint32_t iterations) {
+    shim::reset();
+    Pir pir(0, 0, SENSOR_PIN, PIR_SCENARIO::PLAY_ONCE_WHEN_MOVE);
+    pir.setMaxSound(NB_SON);
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; i++) {
+        pir.pickMusic();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    return {iterations, std::chrono::duration<double, std::nano>(elapsed).count() / iterations, iterations, 0};
+}
+
+void countTrack(const CatalogueTrack& track, void* ctx) {
+    (void)track;
+    (*static_cast<uint32_t*>(ctx))++;
+}
+
+// Full /module/tracks payload with NB_SON entries, fed in 128-byte reads
+// like fetchStep does.
+BenchResult runCatalogue(uint32_t iterations) {
+    std::string payload = "{\"is_error\":false,\"delayMin\":0,\"delaySec\":10,"
+                          "\"delayBefSec\":0,\"data\":[";
+    for (int i = 0; i < NB_SON; i++) {
+        if (i) payload += ",";
+        payload += "{\"id\":" + std::to_string(1000 + i) + ",\"t\":\"Piste_" +
+                   std::to_string(i) + "_Exposition.mp3\",\"s\":" +
+                   std::to_string(2000000 + i) + "}";
+    }
+    payload += "]}";
+
+    uint32_t tracks = 0;
+    CatalogueParser parser;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; i++) {
+        parser.begin(countTrack, &tracks);
+        for (size_t pos = 0; pos < payload.size(); pos += 128) {
+            parser.feed((const uint8_t*)payload.data() + pos,
+                        std::min((size_t)128, payload.size() - pos));
+        }
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    return {iterations, std::chrono::duration<double, std::nano>(elapsed).count() / iterations, tracks, 0};
+}
+
+std::vector<BenchCase> sensorCases() {
+    std::vector<BenchCase> cases;
+    for (int scenario = 1; scenario <= 4; scenario++) {
+        cases.push_back({"pir/" + std::to_string(scenario),
+                         [scenario] { return new Pir(0, 0, SENSOR_PIN, scenario); }});
+    }
+    for (int scenario = 1; scenario <= 4; scenario++) {
+        cases.push_back({"infrarouge/" + std::to_string(scenario),
+                         [scenario] { return new Infrarouge(0, 0, SENSOR_PIN, scenario); }});
+    }
+    for (int scenario = 1; scenario <= 4; scenario++) {
+        cases.push_back({"bouton/" + std::to_string(scenario),
+                         [scenario] { return new Bouton(0, 0, SENSOR_PIN, scenario); }});
+    }
+    cases.push_back({"pir_irq/1", [] { return new Pir(0, 0, IRQ_PIN, 1); }});
+    cases.push_back({"infrarouge_irq/1", [] { return new Infrarouge(0, 0, IRQ_PIN, 1); }});
+    cases.push_back({"bouton_irq/1", [] { return new Bouton(0, 0, IRQ_PIN, 1); }});
+    for (int scenario : {1, 2, 3, 6}) {
+        cases.push_back({"ultrason/" + std::to_string(scenario), [scenario] {
+                             return new Ultrason(0, 0, SENSOR_PIN, scenario, TRIG_PIN, 10, 1, 2);
+                         }});
+    }
+    // PIR vote first, the ultrasonic only polled to confirm it
+    cases.push_back({"groupe/pir+ultrason", [] {
+                         Groupe* groupe = new Groupe(0, 0, 2, 2000);
+                         groupe->add(new Ultrason(0, 0, ECHO_IRQ_PIN, 1, TRIG_PIN, 10, 1, 2), true);
+                         groupe->add(new Pir(0, 0, IRQ_PIN, 1), false);
+                         return groupe;
+                     }});
+    for (int scenario : {1, 2, 3, 6}) {
+        cases.push_back({"ultrason_irq/" + std::to_string(scenario), [scenario] {
+                             return new Ultrason(0, 0, ECHO_IRQ_PIN, scenario, TRIG_PIN, 10, 1, 2);
+                         }});
+    }
+    return cases;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    std::string filter;
+    uint32_t iterations = 200000;
+    bool csv = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-n" && i + 1 < argc) {
+            iterations = strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--csv") {
+            csv = true;
+        } else {
+            filter = arg;
+        }
+    }
+    if (iterations == 0) iterations = 1;
+
+    auto report = [&](const std::string& name, const BenchResult& result) {
+        if (csv) {
+            printf("%s,%u,%.1f,%u,%.1f\n", name.c_str(), result.iterations, result.ns_per_iter,
+                   result.events, result.virtual_seconds);
+        } else {
+            printf("%-24s %10u %12.1f %10u %12.1f\n", name.c_str(), result.iterations,
+                   result.ns_per_iter, result.events, result.virtual_seconds);
+        }
+    };
+
+    if (csv) {
+        printf("case,iterations,ns_per_iter,events,virtual_s\n");
+    } else {
+        printf("%-24s %10s %12s %10s %12s\n", "case", "iterations", "ns/iter", "events",
+               "virtual s");
+    }
+
+    if (filter.empty() || std::string("horloge/tick").find(filter) != std::string::npos) {
+        report("horloge/tick", runTick(iterations));
+    }
+    if (filter.empty() || std::string("scheduler/run").find(filter) != std::string::npos) {
+        report("scheduler/run", runScheduler(iterations));
+    }
+    if (filter.empty() || std::string("capteur/pickMusic").find(filter) != std::string::npos) {
+        report("capteur/pickMusic", runPickMusic(iterations));
+    }
+    if (filter.empty() || std::string("catalogue/parse").find(filter) != std::string::npos) {
+        report("catalogue/parse", runCatalogue(iterations / 100 + 1));
+    }
+    for (const BenchCase& bench : sensorCases()) {
+        std::string name = "loop/" + bench.name;
+        if (!filter.empty() && name.find(filter) == std::string::npos) continue;
+        report(name, runLoop(bench, iterations));
+    }
+    return 0;
+}
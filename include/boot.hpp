@@ -0,0 +1,62 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "stall.hpp"
+
+// Right after the stall records in the RTC user memory, in 4-byte blocks
+#define BOOT_RTC_OFFSET (STALL_RTC_OFFSET + STALL_RTC_BLOCKS)
+#define BOOT_RTC_MAGIC 0x544F4F42UL
+// Duration of a phase that has not ended (yet)
+#define BOOT_PENDING 0xFFFFFFFFUL
+#define BOOT_JSON_SIZE 1024
+
+enum BOOT_PHASE: uint8_t {
+    BOOT_SERIAL = 0,
+    BOOT_WIFI = 1,         // autoConnect(), or the background connection
+    BOOT_SD = 2,
+    BOOT_FETCH_LOCAL = 3,
+    BOOT_CAPTEURS = 4,
+    BOOT_SETUP = 5,        // the whole of setup()
+    BOOT_SYNC = 6,         // first catalogue sync, once the network is up
+    BOOT_NTP = 7,
+    NB_BOOT_PHASES = 8
+};
+
+// Start and duration of the boot phases, in ms since boot, written to RTC
+// memory as each one ends so that the next boot can report them along
+// with the reset that ended this one.
+class BootTimes
+{
+public:
+    // Keeps what the previous boot left, nothing after a power-on, then
+    // starts this boot's record. First thing in setup().
+    void begin();
+
+    // Only the first start and end of a phase count
+    void start(const BOOT_PHASE& phase);
+    void end(const BOOT_PHASE& phase);
+
+    // Logs the previous boot, and the reset that ended it
+    void report() const;
+    // {"reset_reason":..,"phases":{"serial":{"start_ms":..,"duration_ms":..},..},
+    //  "previous":{...}}, null for a phase that did not end. Returns the length.
+    size_t json(char* out, const size_t& size) const;
+
+private:
+    struct Times
+    {
+        uint32_t magic;
+        uint32_t reset_reason;
+        uint32_t start_ms[NB_BOOT_PHASES];
+        uint32_t duration_ms[NB_BOOT_PHASES];
+    };
+
+    static size_t json_(const Times& times, char* out, const size_t& size, size_t len);
+
+    Times current_;
+    Times previous_;
+    bool has_previous_ = false;
+};
+
+const char* resetReasonName(const uint32_t& reason);
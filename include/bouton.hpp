@@ -3,6 +3,7 @@
 #include <Arduino.h>
 
 #include "capteur.hpp"
+#include "edge.hpp"
 
 enum BOUTON_SCENARIO: uint8_t {
     PLAY_AND_RESTART = 1,
@@ -17,5 +18,10 @@ public:
     Bouton(const int& delayMin, const int& delaySec, const uint8_t& pin, const int& scenario);
     ~Bouton();
 
-    bool isTriggered(uint32_t &minutes_since_act, uint8_t &seconds_since_act, uint32_t seconds_since_boot_act_timestamp, const uint32_t &seconds_since_boot, PLAYER_STATE &player_state) override;
+    bool isTriggered(const uint64_t &now_ms, PLAYER_STATE &player_state) override;
+private:
+    EdgeInput input_;
+    uint64_t last_press_ms_ {0};
+
+    bool pressed_(const uint64_t& now_ms);
 };
\ No newline at end of file
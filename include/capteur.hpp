@@ -1,47 +1,78 @@
 #pragma once
 
 #include <Arduino.h>
-#include <ESP8266WiFi.h>
-#include <ESP8266HTTPClient.h>
-#include <ESP8266WebServer.h>
-#include <EEPROM.h>
+
+#include "log.hpp"
 
 #define NB_SON 25
-enum LOG_LEVEL { LOG_INFO, LOG_WARNING, LOG_ERROR };
 enum PLAYER_STATE { PLAYING, PAUSED, STOPPED, WAITING };
 enum CAPTEUR_TYPE: uint8_t {
     PIR = 1,
     BOUTON = 2,
     INFRAROUGE = 3,
-    ULTRASON = 4
+    ULTRASON = 4,
+    GROUPE = 5
 };
 
 class Capteur
 {
 public:
     Capteur(const int& delayMin, const int& delaySec, const uint8_t& pin, const int& scenario);
-    ~Capteur();
+    virtual ~Capteur();
 
-    virtual bool isTriggered(uint32_t &minutes_since_act, uint8_t &seconds_since_act, uint32_t seconds_since_boot_act_timestamp, const uint32_t &seconds_since_boot, PLAYER_STATE &player_state) = 0;
+    // now_ms comes from Horloge, player_state may be changed to stop the track.
+    virtual bool isTriggered(const uint64_t &now_ms, PLAYER_STATE &player_state) = 0;
     virtual void pickMusic();
+    // Index pickMusic() would select now, to warm up that track ahead. When
+    // pickMusic() wraps around and reshuffles, the track there may change.
+    virtual uint8_t nextIndex() const;
+    // A trigger is expected shortly, see Ultrason.
+    virtual bool isApproaching(const uint64_t& now_ms) const { (void)now_ms; return false; }
 
     void setMaxSound(const uint8_t& max_sound);
+    // Tracks of this capteur, as indexes in the stored sound list. Defaults
+    // to all of them in order, setMaxSound() only sets the count.
+    void setPlaylist(const uint8_t* tracks, const uint8_t& count);
+    // False with an empty playlist: such a capteur has nothing to play.
+    bool hasTracks() const { return max_sound_ > 0; }
     uint8_t getCurrentIndex() const { return current_index_; }
+    uint8_t getCurrentTrack() const { return trackAt_(current_index_); }
+    uint8_t getNextTrack() const { return trackAt_(nextIndex()); }
 
-    void updateDelay(const int& delayMin, const int& delaySec);
+    virtual void updateDelay(const int& delayMin, const int& delaySec);
+    // End of an activation: no new trigger before the delay has elapsed.
+    // Applies updateDelay() changes from the next activation on.
+    virtual void rearm(const uint64_t& now_ms);
+    // Windows of the "while" scenarios, 0 keeping the scenario default for
+    // release_ms. See whilePresent_().
+    virtual void updateHold(const uint16_t& hold_ms, const uint16_t& release_ms, const uint16_t& debounce_ms);
 
 protected:
     void randomizeAll_();
+    // Track at index in the playing order, the shuffled playlist.
+    virtual uint8_t trackAt_(const uint8_t& index) const { return playlist_[randomized_indexes_[index]]; }
+    bool isReady_(const uint64_t& now_ms) const { return now_ms >= ready_at_ms_; }
+    // "While" scenarios: starts once presence lasted debounce_ms_ (and
+    // can_start allows it), then keeps going for at least hold_ms_ and until
+    // presence has been gone for the release window.
+    bool whilePresent_(const uint64_t& now_ms, const bool& present, const bool& can_start, const uint16_t& default_release_ms);
 
-    uint16_t delayMin_{0};
-    uint16_t delaySec_{0};
+    uint32_t delay_ms_{0};
+    uint64_t ready_at_ms_{0};
     uint8_t pin_{0};
     uint8_t scenario_{0};
     uint8_t current_index_{0};
-    bool running_;
-    uint8_t loops_since_act_;
+    bool running_{false};
+    uint16_t hold_ms_{0};
+    uint16_t release_ms_{0};
+    uint16_t debounce_ms_{0};
+    bool present_{false};
+    uint64_t present_since_ms_{0};
+    uint64_t last_present_ms_{0};
+    uint64_t running_since_ms_{0};
 
     uint8_t randomized_indexes_[NB_SON];
+    uint8_t playlist_[NB_SON];
 
 private:
     uint8_t max_sound_ = 0;
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <Arduino.h>
+
+#define CATALOGUE_KEY_SIZE 16
+#define CATALOGUE_VALUE_SIZE 64
+#define CATALOGUE_MAX_DEPTH 8
+
+// Track entry of the /module/tracks payload: {"id":..,"t":"..","s":..}
+struct CatalogueTrack
+{
+    int id = 0;
+    int size = 0;
+    char title[CATALOGUE_VALUE_SIZE] = {0};
+};
+
+// Incremental parser for the /module/tracks payload:
+//   {"is_error":false,"delayMin":0,"delaySec":10,"delayBefSec":0,
+//    "holdMs":0,"releaseMs":0,"debounceMs":0,"data":[{"id":1,"t":"title.mp3","s":12345},...]}
+// Bytes can be fed in chunks of any size straight from the network client,
+// memory use is the size of this object whatever the catalogue size. Each
+// complete entry of "data" is handed to the callback as soon as it closes.
+class CatalogueParser
+{
+public:
+    typedef void (*TrackCallback)(const CatalogueTrack& track, void* ctx);
+
+    void begin(TrackCallback on_track, void* ctx);
+    void feed(const uint8_t* data, size_t len);
+
+    // True once the top-level object is closed and "is_error" was false.
+    bool isValid() const { return done_ && !error_ && success_; }
+    bool isDone() const { return done_; }
+    // Malformed input, or an over-long title: the parse is not valid
+    bool hasError() const { return error_; }
+
+    int delayMin() const { return delay_min_; }
+    int delaySec() const { return delay_sec_; }
+    int delayBefSec() const { return delay_bef_sec_; }
+    // Presence windows in ms, 0 keeps the sensor defaults (see Capteur::updateHold).
+    int holdMs() const { return hold_ms_; }
+    int releaseMs() const { return release_ms_; }
+    int debounceMs() const { return debounce_ms_; }
+
+private:
+    void feed_(char c);
+    void push_(bool is_object);
+    void pop_();
+    void endScalar_();
+    void onValue_();
+    void appendValue_(char c);
+    void appendUtf8_(uint16_t code_point);
+    bool topIsObject_() const { return (containers_ >> (depth_ - 1)) & 0x01; }
+
+    TrackCallback on_track_ = nullptr;
+    void* ctx_ = nullptr;
+
+    uint8_t depth_ = 0;
+    uint8_t containers_ = 0;  // one bit per level, 1 = object, 0 = array
+    uint8_t data_depth_ = 0;  // depth of the "data" array, 0 when outside
+    bool in_string_ = false;
+    bool in_scalar_ = false;
+    bool escape_ = false;
+    uint8_t unicode_digits_ = 0;
+    uint16_t unicode_ = 0;
+    bool expecting_key_ = false;
+    bool string_is_key_ = false;
+    bool done_ = false;
+    bool error_ = false;
+    bool success_ = false;
+
+    int delay_min_ = 0;
+    int delay_sec_ = 0;
+    int delay_bef_sec_ = 0;
+    int hold_ms_ = 0;
+    int release_ms_ = 0;
+    int debounce_ms_ = 0;
+
+    char key_[CATALOGUE_KEY_SIZE] = {0};
+    char value_[CATALOGUE_VALUE_SIZE] = {0};
+    uint8_t value_len_ = 0;
+    bool truncated_ = false;  // value_ is missing bytes
+    CatalogueTrack track_;
+};
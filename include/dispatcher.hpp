@@ -0,0 +1,44 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "capteur.hpp"
+
+#define MAX_POSTES 4
+
+// One exhibit point: a capteur with its own playlist (stored tracks whose
+// title starts with prefix, "" for all). The capteur keeps its own delay
+// since the last activation, see Capteur::rearm().
+struct Poste
+{
+    Capteur* capteur = nullptr;
+    const char* prefix = "";
+    uint8_t priority = 0;
+};
+
+// Several postes sharing the single decoder. Each loop() every capteur with
+// tracks is polled; the owner of the decoder sees the real player state, the others
+// see it as stopped. A poste triggering while another one plays only takes
+// the decoder over with a strictly higher priority.
+class Dispatcher
+{
+public:
+    ~Dispatcher();
+
+    // Takes ownership of capteur, false when MAX_POSTES are already used.
+    bool add(Capteur* capteur, const char* prefix, const uint8_t& priority);
+
+    // Returns the poste to feed this loop(), -1 when none is triggered. On a
+    // take-over player_state is set to STOPPED so the caller starts a track.
+    int8_t poll(const uint64_t& now_ms, PLAYER_STATE& player_state);
+
+    // Poste of the track loaded in the decoder.
+    Poste& owner() { return postes_[owner_]; }
+    Poste& poste(const uint8_t& index) { return postes_[index]; }
+    uint8_t size() const { return nb_postes_; }
+
+private:
+    Poste postes_[MAX_POSTES];
+    uint8_t nb_postes_ = 0;
+    uint8_t owner_ = 0;
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <Arduino.h>
+#include <SD.h>
+
+#define DOWNLOAD_SECTOR_SIZE 512
+#define DOWNLOAD_BUFFER_SECTORS 4
+#define DOWNLOAD_READ_TIMEOUT_MS 1000
+#define DOWNLOAD_MAX_READ_TIMEOUTS 10
+#define DOWNLOAD_PROGRESS_MS 1000
+
+struct DownloadMetrics
+{
+    uint32_t bytes = 0;
+    uint32_t duration_ms = 0;
+    uint32_t stall_ms = 0;  // time spent waiting for the network
+    uint32_t sd_write_ms = 0;
+    uint16_t sd_writes = 0;
+    uint16_t read_timeouts = 0;
+
+    uint32_t bytesPerSecond() const { return duration_ms ? (uint64_t)bytes * 1000 / duration_ms : 0; }
+    void log(const char* title) const;
+};
+
+// Staging buffer between the network client and the SD card. The client
+// reads straight into tail(), and the SD card only ever sees whole-buffer,
+// sector-aligned writes except for the last one in finish().
+class SectorWriter
+{
+public:
+    void begin(File* file, DownloadMetrics* metrics);
+
+    uint8_t* tail() { return buffer_ + used_; }
+    size_t room() const { return sizeof(buffer_) - used_; }
+
+    // Accounts for len bytes read into tail(), flushing the buffer when full.
+    bool commit(const size_t& len);
+    bool finish();
+
+private:
+    bool write_();
+
+    File* file_ = nullptr;
+    DownloadMetrics* metrics_ = nullptr;
+    size_t used_ = 0;
+    uint8_t buffer_[DOWNLOAD_SECTOR_SIZE * DOWNLOAD_BUFFER_SECTORS];
+};
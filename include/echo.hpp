@@ -0,0 +1,77 @@
+#pragma once
+
+#include <Arduino.h>
+
+// HC-SR04 style rangefinder: a 10 us pulse on trig, the echo pin then stays
+// HIGH for the sound round trip.
+#define ECHO_MAX_RANGE_CM 400
+#define ECHO_OUT_OF_RANGE 0xFFFF
+// The module bursts for ~0.5 ms before raising echo
+#define ECHO_START_MARGIN_US 1000
+
+#define ECHO_FILTER_SIZE 3
+#define ECHO_FILTER_EMA_SHIFT 2  // alpha = 1/4
+#define ECHO_FILTER_SNAP_CM 20
+
+// Non-blocking echo measurement: start() sends the trigger pulse and returns,
+// a pin-change interrupt timestamps both edges and available()/read() hand
+// out the completed round trip. A measurement with no falling edge within
+// the maximum range round trip completes as out of range.
+//
+// GPIO16 (D0) has no interrupt on the ESP8266: on that pin start() falls back
+// to pulseIn(), bounded by the same range-based timeout instead of 1 s.
+class EchoTimer
+{
+public:
+    EchoTimer(const uint8_t& trig_pin, const uint8_t& echo_pin,
+              const uint16_t& max_range_cm = ECHO_MAX_RANGE_CM);
+    ~EchoTimer();
+
+    // Sends a trigger pulse unless a measurement is still in flight.
+    void start();
+    // True once, when a measurement completes after start().
+    bool available();
+    // Round trip of the last completed measurement in us, 0 if out of range.
+    uint32_t read() const { return echo_us_; }
+
+    bool usesInterrupt() const { return interrupt_; }
+    uint32_t timeoutUs() const { return timeout_us_; }
+
+    static uint16_t toCm(const uint32_t& echo_us);
+
+private:
+    static void IRAM_ATTR onEdge_(void* arg);
+
+    uint8_t trig_pin_;
+    uint8_t echo_pin_;
+    uint32_t max_echo_us_;
+    uint32_t timeout_us_;
+    bool interrupt_ = false;
+
+    volatile bool busy_ = false;
+    volatile bool rising_seen_ = false;
+    volatile bool ready_ = false;
+    volatile uint32_t trig_us_ = 0;
+    volatile uint32_t rise_us_ = 0;
+    volatile uint32_t echo_us_ = 0;
+};
+
+// Integer-only distance filter: median of the last ECHO_FILTER_SIZE echoes
+// drops a single spurious echo, an EMA in 1/16 cm then smooths the jitter.
+// A median move of more than ECHO_FILTER_SNAP_CM restarts the EMA so real
+// approaches are not delayed. Out of range counts as ECHO_MAX_RANGE_CM.
+class EchoFilter
+{
+public:
+    void reset();
+    // Adds a round trip from EchoTimer::read(), returns distanceCm().
+    uint16_t add(const uint32_t& echo_us);
+    uint16_t distanceCm() const { return (ema_cm_x16_ + 8) >> 4; }
+    bool isEmpty() const { return count_ == 0; }
+
+private:
+    uint16_t samples_[ECHO_FILTER_SIZE];
+    uint8_t count_ = 0;
+    uint8_t next_ = 0;
+    int32_t ema_cm_x16_ = 0;
+};
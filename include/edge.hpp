@@ -0,0 +1,74 @@
+#pragma once
+
+#include <Arduino.h>
+
+#define EDGE_QUEUE_SIZE 16  // power of two
+// Keeps the compiler from moving events_ accesses across the index ones.
+// Single core, so no hardware fence is needed.
+#define EDGE_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+struct EdgeEvent
+{
+    uint32_t timestamp_ms = 0;
+    uint8_t level = LOW;
+};
+
+// Single producer (the pin interrupt), single consumer (loop()) ring buffer.
+// Each side only writes its own index, so neither needs to mask interrupts.
+class EdgeQueue
+{
+public:
+    // Returns false and counts an overflow when the queue is full.
+    bool IRAM_ATTR push(const EdgeEvent& event);
+    bool pop(EdgeEvent& event);
+
+    uint16_t overflows() const { return overflows_; }
+
+private:
+    EdgeEvent events_[EDGE_QUEUE_SIZE];
+    volatile uint8_t head_ = 0;
+    volatile uint8_t tail_ = 0;
+    volatile uint16_t overflows_ = 0;
+};
+
+// Digital sensor input fed by timestamped edges: a CHANGE interrupt queues
+// every edge and update() replays them, so a pulse shorter than a loop()
+// iteration is still seen. GPIO16 (D0) has no interrupt on the ESP8266, on
+// that pin update() samples the level instead. Levels go to the sensor trace
+// when it is recording.
+class EdgeInput
+{
+public:
+    EdgeInput() = default;
+    ~EdgeInput();
+    EdgeInput(const EdgeInput&) = delete;
+    EdgeInput& operator=(const EdgeInput&) = delete;
+
+    void begin(const uint8_t& pin);
+
+    // Drains the queued edges, once per isTriggered().
+    void update();
+
+    // Level was HIGH (resp. LOW) at some point since the previous update().
+    bool high() const { return level_ == HIGH || rose_; }
+    bool low() const { return level_ == LOW || fell_; }
+    // At least one rising edge since the previous update().
+    bool rose() const { return rose_; }
+
+    uint32_t lastEdgeMs() const { return last_edge_ms_; }
+    bool usesInterrupt() const { return interrupt_; }
+
+private:
+    static void IRAM_ATTR onEdge_(void* arg);
+    void apply_(const EdgeEvent& event);
+
+    uint8_t pin_ = 0;
+    bool interrupt_ = false;
+    EdgeQueue queue_;
+    uint16_t overflows_seen_ = 0;
+
+    uint8_t level_ = LOW;
+    bool rose_ = false;
+    bool fell_ = false;
+    uint32_t last_edge_ms_ = 0;
+};
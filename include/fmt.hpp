@@ -0,0 +1,8 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Formats at out + len, like snprintf into the room left, and returns the
+// new length. Output stops at size - 1, what does not fit is lost.
+size_t appendFormat(char* out, const size_t& size, size_t len, const char* format, ...)
+    __attribute__((format(printf, 4, 5)));
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "capteur.hpp"
+
+#define GROUPE_MAX_CAPTEURS 4
+
+// Several sensors voting as one: triggered when at least votes_needed of
+// them were triggered within window_ms (0: in this very call). 1 vote is an
+// OR, as many votes as sensors an AND.
+//
+// Cheap sensors are polled first, expensive ones (ultrasonic) only when
+// their vote can still change the outcome, or while a track plays. Cost is bounded by
+// GROUPE_MAX_CAPTEURS polls per call.
+class Groupe : public Capteur
+{
+public:
+    Groupe(const int& delayMin, const int& delaySec, const uint8_t& votes_needed, const uint16_t& window_ms);
+    ~Groupe();
+
+    // Takes ownership of capteur, false when the group is full.
+    bool add(Capteur* capteur, const bool& expensive);
+
+    bool isTriggered(const uint64_t &now_ms, PLAYER_STATE &player_state) override;
+    bool isApproaching(const uint64_t& now_ms) const override;
+    void updateDelay(const int& delayMin, const int& delaySec) override;
+    void rearm(const uint64_t& now_ms) override;
+    void updateHold(const uint16_t& hold_ms, const uint16_t& release_ms, const uint16_t& debounce_ms) override;
+private:
+    bool hasVote_(const uint8_t& index, const uint64_t& now_ms) const;
+
+    Capteur* capteurs_[GROUPE_MAX_CAPTEURS] = {nullptr};
+    uint64_t last_vote_ms_[GROUPE_MAX_CAPTEURS] = {0};
+    bool voted_[GROUPE_MAX_CAPTEURS] = {false};
+    bool voted_now_[GROUPE_MAX_CAPTEURS] = {false};
+    uint8_t nb_capteurs_ = 0;
+    uint8_t nb_cheap_ = 0;
+    uint8_t votes_needed_;
+    uint16_t window_ms_;
+};
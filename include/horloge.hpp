@@ -0,0 +1,15 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Monotonic clock of loop(): millis() extended to 64 bits, so deadlines
+// computed from it never wrap (millis() does after ~49.7 days). tick() only
+// has to run once per wrap period to keep count.
+struct Horloge
+{
+    uint64_t now_ms = 0;
+    uint32_t last_millis = 0;
+
+    // Advances the clock to a millis() reading, returns the 64-bit time.
+    uint64_t tick(const uint32_t& millis_now);
+};
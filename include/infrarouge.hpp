@@ -3,6 +3,7 @@
 #include <Arduino.h>
 
 #include "capteur.hpp"
+#include "edge.hpp"
 
 class Infrarouge : public Capteur
 {
@@ -10,5 +11,7 @@ public:
     Infrarouge(const int& delayMin, const int& delaySec, const uint8_t& pin, const int& scenario);
     ~Infrarouge();
 
-    bool isTriggered(uint32_t &minutes_since_act, uint8_t &seconds_since_act, uint32_t seconds_since_boot_act_timestamp, const uint32_t &seconds_since_boot, PLAYER_STATE &player_state) override;
+    bool isTriggered(const uint64_t &now_ms, PLAYER_STATE &player_state) override;
+private:
+    EdgeInput input_;
 };
\ No newline at end of file
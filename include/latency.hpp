@@ -0,0 +1,45 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "metrics.hpp"
+
+// Stages of the trigger to sound chain, in the order they are reached
+enum LATENCY_STAGE: uint8_t {
+    LATENCY_TRIGGER = 0,       // isTriggered() true, or delayBefSec elapsed
+    LATENCY_START = 1,         // startTrack()
+    LATENCY_PICK = 2,          // pickMusic() done
+    LATENCY_PATH = 3,          // track path copied
+    LATENCY_SETUP = 4,         // setUpTrack() done: source open, decoder begun
+    LATENCY_FIRST_SAMPLE = 5,  // first decoder->loop() done
+    NB_LATENCY_STAGES = 6
+};
+
+// Timestamps, in us, of one trip along the trigger to sound chain. The
+// delayBefSec wait is the visitor's setting, not latency: when there is
+// one, the trip begins once it has elapsed.
+class LatencyTrace
+{
+public:
+    explicit LatencyTrace(Histogram* histogram = nullptr) : histogram_(histogram) {}
+
+    // Stamps LATENCY_TRIGGER, any trip in progress is dropped.
+    void begin();
+    // Ignored outside a trip, so the stages shared with the warm-up or the
+    // waiting track cost nothing.
+    void mark(const LATENCY_STAGE& stage);
+    // Stamps LATENCY_FIRST_SAMPLE, records the total and logs the stages.
+    void end();
+    void cancel() { active_ = false; }
+
+    bool isActive() const { return active_; }
+    // us from LATENCY_TRIGGER, that of the previous stage if skipped (warm track)
+    uint32_t at(const LATENCY_STAGE& stage) const;
+    uint32_t total() const { return at(LATENCY_FIRST_SAMPLE); }
+
+private:
+    Histogram* histogram_;
+    bool active_ = false;
+    uint8_t reached_ = 0;  // bit per stage
+    uint32_t stamps_us_[NB_LATENCY_STAGES] = {0};
+};
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <Arduino.h>
+
+enum LOG_LEVEL { LOG_DEBUG, LOG_INFO, LOG_WARNING, LOG_ERROR };
+
+// Calls below this level compile away, arguments included. Set it from the
+// build flags, e.g. -DLOG_LEVEL_MIN=LOG_WARNING for a quiet module.
+#ifndef LOG_LEVEL_MIN
+#define LOG_LEVEL_MIN LOG_INFO
+#endif
+
+#define LOG_BUFFER_SIZE 2048  // power of two
+#define LOG_LINE_SIZE 160
+
+#ifndef LOG_TOKENIZED
+
+// Formats a line into the log ring buffer, written to Serial by logDrain().
+// A line that does not fit is dropped and counted, never waited for.
+#define printLog(function, level, ...)                        \
+    do {                                                      \
+        if ((level) >= LOG_LEVEL_MIN) {                       \
+            logWrite(function, level, __VA_ARGS__);           \
+        }                                                     \
+    } while (0)
+
+#else
+
+#include <type_traits>
+
+#define LOG_RECORD_SIZE 48
+#define LOG_STRING_SIZE 24
+
+// Tokenized mode (-DLOG_TOKENIZED): the format string is replaced by its hash
+// at compile time and never reaches flash, the arguments are sent raw. Each
+// call pushes one line "$<base64 record>" into the same ring as text mode, so
+// the ROM, SDK and library prints still come through in between.
+//
+// Record: token u32 LE | level u8 | varint millis | arguments
+//   integers  zigzag varint
+//   strings   varint length | bytes, cut at LOG_STRING_SIZE
+//   floats    float32 LE
+// A record full before the last argument is sent without the remaining ones.
+//
+// tools/log_tokens.py rebuilds the table from the sources at build time and
+// turns a serial capture back into text.
+#define printLog(function, level, message, ...)                       \
+    do {                                                              \
+        if ((level) >= LOG_LEVEL_MIN) {                               \
+            constexpr uint32_t token_ = logToken(message);            \
+            logTokenized(token_, level, ##__VA_ARGS__);               \
+        }                                                             \
+    } while (0)
+
+// 32-bit FNV-1a of the format string, must match tools/log_tokens.py.
+constexpr uint32_t logToken(const char* message, const uint32_t hash = 2166136261UL) {
+    return *message ? logToken(message + 1, (uint32_t)((hash ^ (uint8_t)*message) * 16777619ULL))
+                    : hash;
+}
+
+class LogRecord
+{
+public:
+    LogRecord(const uint32_t& token, LOG_LEVEL level);
+
+    void addInteger(const int64_t& value);
+    void addString(const char* value);
+    void addFloat(const float& value);
+    // Pushes the record into the ring buffer
+    void commit();
+
+private:
+    void addVarint_(uint64_t value);
+
+    uint8_t data_[LOG_RECORD_SIZE];
+    uint8_t len_ = 0;
+};
+
+template <typename T>
+inline typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type
+logArgument(LogRecord& record, const T& value) {
+    record.addInteger((int64_t)value);
+}
+
+template <typename T>
+inline typename std::enable_if<std::is_floating_point<T>::value>::type
+logArgument(LogRecord& record, const T& value) {
+    record.addFloat(value);
+}
+
+inline void logArgument(LogRecord& record, const char* value) {
+    record.addString(value);
+}
+
+inline void logArguments(LogRecord& record) {
+    (void)record;
+}
+
+template <typename T, typename... Args>
+inline void logArguments(LogRecord& record, const T& value, const Args&... args) {
+    logArgument(record, value);
+    logArguments(record, args...);
+}
+
+template <typename... Args>
+void logTokenized(const uint32_t& token, LOG_LEVEL level, const Args&... args) {
+    LogRecord record(token, level);
+    logArguments(record, args...);
+    record.commit();
+}
+
+#endif
+
+void logWrite(const char* function, LOG_LEVEL level, const char* message, ...);
+
+// Writes what the UART FIFO takes right now, without blocking.
+void logDrain();
+// Writes everything, blocking, e.g. before a restart.
+void logFlush();
+// Until enabled, every line is flushed as soon as written (setup()).
+void logSetAsync(const bool& async);
+uint32_t logDropped();
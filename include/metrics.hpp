@@ -0,0 +1,112 @@
+#pragma once
+
+#include <Arduino.h>
+
+#define METRICS_MAX 16
+#define HISTOGRAM_MAX_BUCKETS 12
+// Enough for the largest metric, a histogram with its HELP/TYPE lines
+#define METRICS_CHUNK_SIZE 1536
+#define METRICS_CONTENT_TYPE "text/plain; version=0.0.4"
+
+enum METRIC_TYPE: uint8_t {
+    COUNTER = 0,
+    GAUGE = 1,
+    HISTOGRAM = 2
+};
+
+// Metric of the /metrics endpoint, owned by the caller like a Task. Updates
+// are a few integer operations, text is only built when scraped.
+// Metrics sharing a name (one family, different labels) are added in a row.
+class Metric
+{
+public:
+    // labels without braces, e.g. "phase=\"pump\"", nullptr for none
+    Metric(const char* name, const char* help, const char* labels = nullptr)
+        : name(name), help(help), labels(labels) {}
+    virtual ~Metric() {}
+
+    virtual METRIC_TYPE type() const = 0;
+    // Writes the samples in the Prometheus text format, no HELP/TYPE lines,
+    // from out + len on. Returns the new length, at most size - 1.
+    virtual size_t write(char* out, const size_t& size, size_t len) const = 0;
+
+    const char* name;
+    const char* help;
+    const char* labels;
+
+protected:
+    size_t writeSample_(char* out, const size_t& size, size_t len, const char* suffix, const char* le,
+                        const uint64_t& value) const;
+};
+
+class Counter : public Metric
+{
+public:
+    using Metric::Metric;
+
+    void inc(const uint32_t& n = 1) { value_ += n; }
+    uint64_t value() const { return value_; }
+
+    METRIC_TYPE type() const override { return METRIC_TYPE::COUNTER; }
+    size_t write(char* out, const size_t& size, size_t len) const override;
+
+private:
+    uint64_t value_ = 0;
+};
+
+class Gauge : public Metric
+{
+public:
+    using Metric::Metric;
+
+    void set(const uint32_t& value) { value_ = value; }
+    uint32_t value() const { return value_; }
+
+    METRIC_TYPE type() const override { return METRIC_TYPE::GAUGE; }
+    size_t write(char* out, const size_t& size, size_t len) const override;
+
+private:
+    uint32_t value_ = 0;
+};
+
+// Fixed upper bounds, ascending, the +Inf bucket is implicit.
+class Histogram : public Metric
+{
+public:
+    Histogram(const char* name, const char* help, const uint32_t* bounds, const uint8_t& nb_bounds,
+              const char* labels = nullptr);
+
+    void observe(const uint32_t& value) {
+        uint8_t bucket = 0;
+        while (bucket < nb_bounds_ && value > bounds_[bucket]) {
+            bucket++;
+        }
+        counts_[bucket]++;
+        sum_ += value;
+    }
+
+    METRIC_TYPE type() const override { return METRIC_TYPE::HISTOGRAM; }
+    size_t write(char* out, const size_t& size, size_t len) const override;
+
+private:
+    const uint32_t* bounds_;
+    uint8_t nb_bounds_;
+    uint32_t counts_[HISTOGRAM_MAX_BUCKETS + 1] = {0};
+    uint64_t sum_ = 0;
+};
+
+class Metrics
+{
+public:
+    // false when METRICS_MAX are already registered.
+    bool add(Metric& metric);
+
+    // Writes one metric, preceded by HELP/TYPE if it starts a family, so
+    // that the page can be sent a metric per chunk. Returns the length.
+    size_t write(const uint8_t& index, char* out, const size_t& size) const;
+    uint8_t size() const { return nb_metrics_; }
+
+private:
+    Metric* metrics_[METRICS_MAX] = {nullptr};
+    uint8_t nb_metrics_ = 0;
+};
@@ -1,12 +1,9 @@
 #pragma once
 
 #include <Arduino.h>
-#include <ESP8266WiFi.h>
-#include <ESP8266HTTPClient.h>
-#include <ESP8266WebServer.h>
-#include <EEPROM.h>
 
 #include "capteur.hpp"
+#include "edge.hpp"
 
 enum PIR_SCENARIO: uint8_t {
     PLAY_ONCE_WHEN_MOVE = 1,
@@ -21,5 +18,7 @@ public:
     Pir(const int& delayMin, const int& delaySec, const uint8_t& pin, const int& scenario);
     ~Pir();
 
-    bool isTriggered(uint32_t &minutes_since_act, uint8_t &seconds_since_act, uint32_t seconds_since_boot_act_timestamp, const uint32_t &seconds_since_boot,  PLAYER_STATE &player_state) override;
+    bool isTriggered(const uint64_t &now_ms, PLAYER_STATE &player_state) override;
+private:
+    EdgeInput input_;
 };
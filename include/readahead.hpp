@@ -0,0 +1,78 @@
+#pragma once
+
+#include <Arduino.h>
+#include <SD.h>
+
+#include "AudioFileSource.h"
+#include "metrics.hpp"
+
+#define READAHEAD_SECTOR_SIZE 512
+// Per buffer, so that one buffer covers the first fill of AudioGeneratorMP3
+// (1536 bytes) and the two always do, wherever the audio starts in a sector
+#define READAHEAD_SECTORS 3
+#define READAHEAD_BUFFER_SIZE (READAHEAD_SECTOR_SIZE * READAHEAD_SECTORS)
+#define ID3_HEADER_SIZE 10
+
+struct ReadAheadMetrics
+{
+    uint32_t reads = 0;
+    uint32_t hits = 0;  // reads served from RAM only
+    uint32_t refills = 0;
+    uint32_t refill_us = 0;
+    uint32_t refill_max_us = 0;
+
+    uint8_t hitPercent() const { return reads ? (uint64_t)hits * 100 / reads : 100; }
+    void log(const char* title) const;
+};
+
+// File source for the decoder that only reads the card a whole, sector
+// aligned buffer at a time. Of its two buffers, the one the decoder reads
+// from and the next part of the file, the one left behind is refilled from
+// loop(), which AudioGeneratorMP3 calls once its frame is decoded: reads
+// come from RAM but after a seek, or when the decoder outruns loop(). The
+// ID3v2 tag is skipped, the decoder would only read through it looking for
+// a frame.
+class ReadAheadSource : public AudioFileSource
+{
+public:
+    explicit ReadAheadSource(Histogram* refill_duration = nullptr) : refill_duration_(refill_duration) {}
+
+    // Fills both buffers, not counted in metrics() nor refill_duration
+    bool open(const char* path) override;
+    uint32_t read(void* data, uint32_t len) override;
+    bool seek(int32_t pos, int dir) override;
+    bool close() override;
+    bool isOpen() override { return (bool)file_; }
+    // Without the ID3v2 tag
+    uint32_t getSize() override { return file_ ? file_.size() - start_ : 0; }
+    uint32_t getPos() override { return pos_; }
+    bool loop() override;
+
+    // Since open()
+    const ReadAheadMetrics& metrics() const { return metrics_; }
+
+protected:
+    const char* path() const { return path_; }
+
+    ReadAheadMetrics metrics_;
+
+private:
+    struct Buffer
+    {
+        uint32_t offset = 0;  // in the file, sector aligned
+        uint16_t len = 0;
+        uint8_t data[READAHEAD_BUFFER_SIZE];
+
+        bool holds(const uint32_t& at) const { return at >= offset && at < offset + len; }
+    };
+
+    Buffer* find_(const uint32_t& at);
+    bool fill_(Buffer& buffer, const uint32_t& offset, const bool& measured = true);
+
+    Histogram* refill_duration_;
+    File file_;
+    char path_[64] = {0};
+    uint32_t start_ = 0;  // in the file, past the ID3v2 tag
+    uint32_t pos_ = 0;    // from start_
+    Buffer buffers_[2];
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "log.hpp"
+#include "metrics.hpp"
+#include "stall.hpp"
+#include "timer.hpp"
+
+#define SCHEDULER_MAX_TASKS 8
+// Tasks of this priority also run between any two other tasks of a pass
+#define SCHEDULER_CRITICAL 0
+
+// Unit of work of loop(), owned by the caller like a Timer. run() must
+// return quickly: long jobs keep their state and do a slice per call.
+struct Task
+{
+    typedef void (*Run)(void* ctx);
+
+    Task(const char* name, Run run, const uint8_t& priority, const uint32_t& period_ms = 0,
+         void* ctx = nullptr);
+
+    const char* name;
+    Run run;
+    void* ctx;
+    uint8_t priority;    // lower runs first
+    uint32_t period_ms;  // 0: every pass, else woken that long after each run
+
+    // CPU accounting since boot
+    uint32_t runs = 0;
+    uint64_t busy_us = 0;
+    uint32_t max_us = 0;
+    // Run durations in us, optional
+    Histogram* duration = nullptr;
+
+    // Scheduler bookkeeping
+    bool ready = true;
+    bool suspended = false;
+    Timer wake;
+};
+
+// Cooperative scheduler: each run() is one pass over the ready tasks in
+// priority order, with the SCHEDULER_CRITICAL ones (decoder pump) serviced
+// again after every other task so they never wait for more than one slice.
+// Wakeups are deadlines on the TimerWheel, a sleeping task costs nothing.
+class Scheduler
+{
+public:
+    explicit Scheduler(TimerWheel& timers) : timers_(timers) {}
+
+    // false when SCHEDULER_MAX_TASKS are already registered.
+    bool add(Task& task);
+    void run();
+
+    // Not before ms from now, overriding the period for this once.
+    void sleep(Task& task, const uint32_t& ms);
+    // Until wake(), which makes it ready for the next pass.
+    void suspend(Task& task);
+    void wake(Task& task);
+
+    // Tasks are entered and exited as phases of stalls, their index
+    // in the run order being the phase.
+    void watch(StallDetector& stalls) { stalls_ = &stalls; }
+
+    // Logs the CPU accounting of every task.
+    void report() const;
+    uint8_t size() const { return nb_tasks_; }
+    const Task& task(const uint8_t& index) const { return *tasks_[index]; }
+
+private:
+    void run_(Task& task, const uint8_t& index);
+
+    TimerWheel& timers_;
+    StallDetector* stalls_ = nullptr;
+    Task* tasks_[SCHEDULER_MAX_TASKS] = {nullptr};
+    uint8_t nb_tasks_ = 0;
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <Arduino.h>
+
+// loop() iterations longer than this are recorded as stalls
+#ifndef STALL_BUDGET_MS
+#define STALL_BUDGET_MS 100
+#endif
+#define STALL_RECORDS 8
+// In 4-byte blocks of the RTC user memory, the first 32 are eboot's (OTA)
+#define STALL_RTC_OFFSET 32
+#define STALL_RTC_BLOCKS (3 + STALL_RECORDS * 4)
+#define STALL_RTC_MAGIC 0x4C415453UL
+
+// Phases are the Scheduler task indexes, plus these
+#define STALL_PHASE_NONE 0xFF
+#define STALL_PHASE_SETUP 0xFE
+#define STALL_PHASE_TIMERS 0xFD
+
+struct StallRecord
+{
+    uint32_t at_ms = 0;  // uptime at the end of the iteration
+    uint32_t iteration_us = 0;
+    uint32_t phase_us = 0;  // longest phase of the iteration
+    uint8_t phase = STALL_PHASE_NONE;
+    uint8_t reserved[3] = {0};
+};
+
+// Times loop() iterations and the phases inside them, and keeps the last
+// STALL_RECORDS iterations over budget in RTC memory, which soft and
+// watchdog resets leave alone. The phase entered is written there too, so
+// that the next boot knows which one a watchdog reset interrupted.
+class StallDetector
+{
+public:
+    typedef const char* (*PhaseName)(const uint8_t& phase);
+
+    explicit StallDetector(const uint32_t& budget_ms = STALL_BUDGET_MS) : budget_us_(budget_ms * 1000) {}
+
+    // Loads what the previous boot left, nothing after a power-on, and
+    // enters STALL_PHASE_SETUP. First thing in setup().
+    void begin(PhaseName phase_name);
+    // Logs the previous boot's stalls and reset phase, once phase_name()
+    // knows the phases.
+    void report() const;
+
+    void beginIteration();
+    void enter(const uint8_t& phase);
+    void exit();
+    // Records and logs the iteration if over budget
+    void endIteration();
+
+    // Phase the previous boot was in when reset by a watchdog or an
+    // exception, STALL_PHASE_NONE for any other reset.
+    uint8_t resetPhase() const { return reset_phase_; }
+    // Stalls since power-on, the last STALL_RECORDS kept
+    uint32_t count() const { return state_.count; }
+    // 0 is the most recent
+    const StallRecord& record(const uint8_t& index) const;
+
+private:
+    // RTC memory layout from STALL_RTC_OFFSET, in 4-byte blocks
+    struct State
+    {
+        uint32_t magic;
+        uint32_t phase;
+        uint32_t count;
+        StallRecord records[STALL_RECORDS];
+    };
+
+    static_assert(sizeof(State) == STALL_RTC_BLOCKS * 4, "STALL_RTC_BLOCKS out of date");
+
+    const char* name_(const uint8_t& phase) const;
+
+    State state_;
+    PhaseName phase_name_ = nullptr;
+    uint8_t reset_phase_ = STALL_PHASE_NONE;
+    uint8_t previous_count_ = 0;  // records left by the previous boots
+    uint32_t budget_us_;
+
+    uint32_t iteration_start_us_ = 0;
+    uint32_t phase_start_us_ = 0;
+    uint8_t phase_ = STALL_PHASE_NONE;
+    uint32_t worst_us_ = 0;
+    uint8_t worst_phase_ = STALL_PHASE_NONE;
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Slots of the wheel (power of two) and slot width as a shift of ms: one
+// turn covers 32 * 128 ms, longer deadlines wait in their slot for as many
+// turns as needed.
+#define TIMER_WHEEL_SLOTS 32
+#define TIMER_WHEEL_TICK_SHIFT 7
+
+// Deadline owned by the caller, usually a global, linked into the wheel
+// while armed. The callback runs from TimerWheel::advance() in loop(), not
+// from an interrupt, and may schedule or cancel any timer. Timers armed by
+// a callback for a deadline already due fire on the next advance().
+struct Timer
+{
+    typedef void (*Callback)(void* ctx);
+
+    Timer(Callback callback, void* ctx = nullptr, const uint32_t& period_ms = 0)
+        : callback(callback), ctx(ctx), period_ms(period_ms) {}
+
+    Callback callback;
+    void* ctx;
+    uint32_t period_ms;  // re-armed that far after firing, 0 for one-shot
+    uint64_t deadline_ms = 0;
+    bool armed = false;
+    // Wheel bookkeeping
+    Timer* next = nullptr;
+    uint8_t slot = 0;
+    uint32_t round = 0;
+};
+
+// Hashed timer wheel on the 64-bit clock of Horloge: scheduling and
+// cancelling cost a slot list walk, advance() only looks at the slots
+// elapsed since the previous call, so loop() pays for the deadlines that
+// are due rather than re-checking every one of them.
+class TimerWheel
+{
+public:
+    // Fires every timer whose deadline is <= now_ms.
+    void advance(const uint64_t& now_ms);
+
+    // Arms timer delay_ms after the last advance(), re-arming it if needed.
+    void schedule(Timer& timer, const uint32_t& delay_ms);
+    void scheduleAt(Timer& timer, const uint64_t& deadline_ms);
+    void cancel(Timer& timer);
+
+    uint64_t now() const { return now_ms_; }
+
+private:
+    Timer* slots_[TIMER_WHEEL_SLOTS] = {nullptr};
+    uint64_t now_ms_ = 0;
+    uint64_t tick_ = 0;
+    uint32_t round_ = 0;
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <Arduino.h>
+#include <SD.h>
+
+// Compact binary sensor trace, recorded on the module and replayed on the
+// host by the [env:native_replay] build.
+//
+// File layout (little endian):
+//   header  "MAST" | version u8 | capteur type u8 | scenario u8 | reserved u8
+//           | delayMin u16 | delaySec u16 | min_distance u16
+//           | time_within_minimum_sec u16 | time_within_minimum_sec_2 u16
+//   records varint delta_ms | tag u8 | [varint echo_us if kind == ECHO]
+//           | [varint delayMin | varint delaySec if kind == DELAY]
+//           tag = kind << 6 | level << 5 | pin
+// The header delays are the ones at boot, before any catalogue sync: the
+// delays the server sets come as DELAY records (version 2).
+#define TRACE_PATH "/trace.bin"
+#define TRACE_VERSION 2
+#define TRACE_HEADER_SIZE 18
+#define TRACE_RECORD_MAX_SIZE 12
+#define TRACE_BUFFER_SIZE 512
+
+enum TRACE_KIND: uint8_t {
+    PIN_LEVEL = 0,
+    ECHO = 1,
+    TRIGGER = 2,
+    DELAY = 3
+};
+
+struct TraceHeader
+{
+    uint8_t capteur_type = 0;
+    uint8_t scenario = 0;
+    uint16_t delay_min = 0;
+    uint16_t delay_sec = 0;
+    uint16_t min_distance = 0;
+    uint16_t time_within_minimum_sec = 0;
+    uint16_t time_within_minimum_sec_2 = 0;
+};
+
+struct TraceRecord
+{
+    uint32_t timestamp_ms = 0;
+    TRACE_KIND kind = TRACE_KIND::PIN_LEVEL;
+    uint8_t pin = 0;
+    uint8_t level = 0;
+    uint32_t echo_us = 0;
+    uint16_t delay_min = 0;
+    uint16_t delay_sec = 0;
+};
+
+size_t encodeTraceHeader(const TraceHeader& header, uint8_t* out);
+bool decodeTraceHeader(const uint8_t* in, size_t len, TraceHeader& header);
+
+// Both return the number of bytes used, 0 if the input is truncated.
+// last_ms carries the timestamp of the previous record between calls.
+size_t encodeTraceRecord(const TraceRecord& record, uint32_t& last_ms, uint8_t* out);
+size_t decodeTraceRecord(const uint8_t* in, size_t len, uint32_t& last_ms, TraceRecord& record);
+
+class TraceRecorder
+{
+public:
+    bool begin(const char* path, const TraceHeader& header);
+    void end();
+    bool isActive() const { return active_; }
+
+    // Only level changes are kept, so this can be called every loop().
+    void pin(const uint8_t& pin, const uint8_t& level);
+    void echo(const uint8_t& pin, const uint32_t& duration_us);
+    void trigger();
+    void delay(const uint16_t& delay_min, const uint16_t& delay_sec);
+
+    void flush();
+
+private:
+    void append_(const TraceRecord& record);
+
+    File file_;
+    bool active_ = false;
+    uint32_t last_ms_ = 0;
+    uint32_t pin_levels_ = 0;
+    uint32_t pins_seen_ = 0;
+    uint16_t used_ = 0;
+    uint8_t buffer_[TRACE_BUFFER_SIZE];
+};
+
+extern TraceRecorder traceRecorder;
@@ -3,6 +3,9 @@
 #include <Arduino.h>
 
 #include "capteur.hpp"
+#include "echo.hpp"
+
+#define ULTRASON_HISTORY_SIZE 4
 
 enum ULTRASON_SCENARIO: uint8_t {
     PLAY_ONCE_WHEN_WITHIN = 1,
@@ -26,18 +29,44 @@ public:
     Ultrason(const int& delayMin, const int& delaySec, const uint8_t& echo_pin, const int& scenario, const uint8_t& trig_pin, const uint16_t& min_distance, const uint16_t& time_within_minimum_sec, const uint16_t& time_within_minimum_sec2);
     ~Ultrason();
 
-    bool isTriggered(uint32_t &minutes_since_act, uint8_t &seconds_since_act, uint32_t seconds_since_boot_act_timestamp, const uint32_t &seconds_since_boot, PLAYER_STATE &player_state) override;
+    bool isTriggered(const uint64_t &now_ms, PLAYER_STATE &player_state) override;
     void pickMusic() override;
+    uint8_t nextIndex() const override;
+    bool isApproaching(const uint64_t& now_ms) const override;
+protected:
+    uint8_t trackAt_(const uint8_t& index) const override;
 private:
+    struct Sample
+    {
+        uint32_t timestamp_ms;
+        uint16_t distance_cm;
+    };
+
     uint8_t trig_pin_;
     uint16_t min_distance_;
     uint16_t time_within_minimum_sec_;
     uint16_t time_within_minimum_sec_2_;
     ULTRASON_STATE state_ {ULTRASON_STATE::OUTSIDE};
+    uint32_t last_try_timestamp_ms_ {0};
+    uint32_t last_sucessful_try_timestamp_ms_ {0};
+    PLAYER_STATE last_player_state_ {PLAYER_STATE::STOPPED};
+    EchoTimer echo_;
+    EchoFilter filter_;
+    uint16_t distance_cm_ {ECHO_OUT_OF_RANGE};
+    bool within_ {false};
+    bool approaching_ {false};
+    bool stable_ {false};
+    Sample history_[ULTRASON_HISTORY_SIZE];
+    uint8_t history_count_ {0};
+    uint8_t history_next_ {0};
+    uint32_t echo_start_ms_ {0};
 
-    uint16_t measureDistance_();
-    bool stayedInside_(uint32_t& last_sucessful_try_timestamp_ms);
-    bool logicTriggerTimeThresholdInside_(PLAYER_STATE& player_state, uint32_t& last_try_timestamp_ms, uint32_t& last_sucessful_try_timestamp_ms);
+    uint16_t measureDistance_(const uint32_t& now);
+    void readEcho_(const uint32_t& now);
+    bool isWithin_(const uint32_t& now);
+    uint16_t pollPeriodMs_() const;
+    bool stayedInside_(const uint32_t& now);
+    bool logicTriggerTimeThresholdInside_(const uint32_t& now, PLAYER_STATE& player_state);
     void stateMachine_();
     void pickMusicSpecial_();
 };
\ No newline at end of file
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "readahead.hpp"
+
+// Track source whose file can be opened and first frames read ahead, while
+// nothing plays from it: open() of that track then costs no SD access and
+// the decoder starts from RAM, the two buffers of ReadAheadSource holding
+// its first fill. It also tells which track a decoder was begun on ahead of
+// its trigger, see handleWarmUp().
+class WarmSource : public ReadAheadSource
+{
+public:
+    explicit WarmSource(Histogram* refill_duration = nullptr) : ReadAheadSource(refill_duration) {}
+
+    // Opens path and buffers its first frames, any other track is closed.
+    // Idle work, it takes an SD open and a few sector reads.
+    bool prepare(const char* path);
+    // Opened by prepare() and not read since
+    bool isPrepared(const char* path) const;
+
+    // A decoder was begun on the open file, which is track. Forgotten once
+    // the file is closed or another one opened: a sync deleting that track
+    // cannot leave it warm.
+    void setWarm(const uint8_t& track) { warm_track_ = isOpen() ? track : -1; }
+    // Track of the warm decoder, -1 if none
+    int16_t warmTrack() const { return warm_track_; }
+    // True when the warm decoder is on track, which then plays: no longer warm.
+    bool takeWarm(const uint8_t& track);
+
+    // Free when path is prepared, opens it otherwise
+    bool open(const char* path) override;
+    uint32_t read(void* data, uint32_t len) override;
+    bool seek(int32_t pos, int dir) override;
+    bool close() override;
+
+private:
+    bool prepared_ = false;
+    int16_t warm_track_ = -1;
+};
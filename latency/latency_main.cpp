@@ -0,0 +1,259 @@
+// Host benchmark of the trigger to first sample latency, built by
+// [env:native_latency].
+//
+//   pio run -e native_latency && .pio/build/native_latency/program sd_dir
+//       [-n triggers] [--open-us us] [--byte-ns ns] [--target-us us] [--cold] [--csv]
+//
+// sd_dir is a copy of a module's SD card (the *.mp3 of the catalogue). Each
+// trigger walks the chain of startTrack() on the virtual clock: a Pir sees
+// its pin rise, picks a track, opens it and reads it until the first MP3
+// frame is whole, which is what the first decoder->loop() waits for. The SD
+// card costs virtual time per open and per byte (SD.setTiming()), 4 MHz SPI
+// by default, the speed main.cpp sets, and is all that costs time: the
+// decode itself is not modelled. Exits 1 when a trigger takes longer
+// than --target-us, so the target can be enforced.
+//
+// Between triggers the next track is prepared in a WarmSource, like
+// prepareNextTrack() does. --cold opens it at the trigger instead, as
+// AudioFileSourceSD did.
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <Arduino.h>
+#include <SD.h>
+
+#include "AudioFileSource.h"
+#include "latency.hpp"
+#include "metrics.hpp"
+#include "pir.hpp"
+#include "warm.hpp"
+
+namespace {
+
+constexpr uint8_t PIR_PIN = D0;
+// Read size of AudioGeneratorMP3, and of its first fill
+constexpr size_t DECODER_BUFFER_SIZE = 1536;
+// SD_SCK_MHZ(4): 2 us a byte once SPI and FAT overhead are counted,
+// about 3 ms to walk the directory and the FAT for an open
+constexpr uint32_t DEFAULT_OPEN_US = 3000;
+constexpr uint32_t DEFAULT_BYTE_NS = 2000;
+constexpr uint32_t LATENCY_BOUNDS_US[] = {1000,   2000,   5000,   10000,  20000,  50000,
+                                          100000, 200000, 500000, 1000000};
+
+// MPEG-1 Layer III, in kbit/s and Hz, and the MPEG-2/2.5 ones
+constexpr uint16_t BITRATES_V1[16] = {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0};
+constexpr uint16_t BITRATES_V2[16] = {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0};
+constexpr uint32_t SAMPLERATES[3] = {44100, 48000, 32000};
+
+// Bytes of the Layer III frame whose header is at data, 0 if not one
+size_t frameSize(const uint8_t* data) {
+    if (data[0] != 0xFF || (data[1] & 0xE0) != 0xE0) return 0;
+    uint8_t version = (data[1] >> 3) & 0x03;  // 3: MPEG-1, 2: MPEG-2, 0: MPEG-2.5
+    uint8_t layer = (data[1] >> 1) & 0x03;    // 1: Layer III
+    uint8_t bitrate_index = data[2] >> 4;
+    uint8_t samplerate_index = (data[2] >> 2) & 0x03;
+    uint8_t padding = (data[2] >> 1) & 0x01;
+    if (version == 1 || layer != 1 || samplerate_index == 3) return 0;
+
+    uint32_t bitrate = (version == 3 ? BITRATES_V1 : BITRATES_V2)[bitrate_index] * 1000UL;
+    uint32_t samplerate = SAMPLERATES[samplerate_index] >> (version == 3 ? 0 : version == 2 ? 1 : 2);
+    if (bitrate == 0) return 0;
+    return (version == 3 ? 144 : 72) * bitrate / samplerate + padding;
+}
+
+// AudioFileSourceSD, reads straight from the card
+class FileSource : public AudioFileSource
+{
+public:
+    bool open(const char* path) override {
+        file_ = SD.open(path);
+        return (bool)file_;
+    }
+    uint32_t read(void* data, uint32_t len) override {
+        int read = file_.read(static_cast<uint8_t*>(data), len);
+        return read > 0 ? read : 0;
+    }
+    bool close() override {
+        file_.close();
+        return true;
+    }
+    bool isOpen() override { return (bool)file_; }
+
+private:
+    File file_;
+};
+
+// Reads source like the first decoder->loop(): buffers until the ID3v2 tag,
+// if any, is behind and a whole frame is in. Returns the bytes read, 0 if
+// the source holds no frame.
+size_t readFirstFrame(AudioFileSource& source) {
+    std::vector<uint8_t> data;
+    uint8_t buffer[DECODER_BUFFER_SIZE];
+    size_t scan = 0;
+    bool tag_checked = false;
+    while (true) {
+        uint32_t len = source.read(buffer, sizeof(buffer));
+        if (len == 0) return 0;
+        data.insert(data.end(), buffer, buffer + len);
+
+        if (!tag_checked && data.size() >= 10) {
+            tag_checked = true;
+            if (data[0] == 'I' && data[1] == 'D' && data[2] == '3') {
+                // Syncsafe size, without the header and the footer
+                scan = 10 + ((data[6] & 0x7F) << 21 | (data[7] & 0x7F) << 14 | (data[8] & 0x7F) << 7 |
+                             (data[9] & 0x7F));
+                if (data[5] & 0x10) scan += 10;
+            }
+        }
+        for (; tag_checked && scan + 4 <= data.size(); scan++) {
+            size_t size = frameSize(&data[scan]);
+            if (size == 0) continue;
+            if (scan + size > data.size()) break;  // more to read
+            return data.size();
+        }
+    }
+}
+
+std::vector<std::string> listTracks() {
+    std::vector<std::string> tracks;
+    File root = SD.open("/");
+    for (File entry = root.openNextFile(); entry; entry = root.openNextFile()) {
+        std::string name = entry.name();
+        if (name.size() > 4 && name.compare(name.size() - 4, 4, ".mp3") == 0 && name != "waiting.mp3") {
+            tracks.push_back(entry.fullName());
+        }
+    }
+    std::sort(tracks.begin(), tracks.end());
+    return tracks;
+}
+
+uint32_t percentile(std::vector<uint32_t> values, const uint8_t& pct) {
+    std::sort(values.begin(), values.end());
+    return values[(values.size() - 1) * pct / 100];
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const char* dir = nullptr;
+    uint32_t triggers = 25;
+    uint32_t open_us = DEFAULT_OPEN_US;
+    uint32_t byte_ns = DEFAULT_BYTE_NS;
+    uint32_t target_us = 0;
+    bool cold = false;
+    bool csv = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-n" && i + 1 < argc) {
+            triggers = strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--open-us" && i + 1 < argc) {
+            open_us = strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--byte-ns" && i + 1 < argc) {
+            byte_ns = strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--target-us" && i + 1 < argc) {
+            target_us = strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--cold") {
+            cold = true;
+        } else if (arg == "--csv") {
+            csv = true;
+        } else {
+            dir = argv[i];
+        }
+    }
+    if (!dir || triggers == 0) {
+        fprintf(stderr, "usage: %s sd_dir [-n triggers] [--open-us us] [--byte-ns ns] "
+                        "[--target-us us] [--cold] [--csv]\n", argv[0]);
+        return 2;
+    }
+
+    shim::reset();
+    SD.format();
+    if (!SD.loadImage(dir)) {
+        fprintf(stderr, "%s: cannot load SD image\n", dir);
+        return 1;
+    }
+    std::vector<std::string> tracks = listTracks();
+    if (tracks.empty() || tracks.size() > NB_SON) {
+        fprintf(stderr, "%s: %zu tracks, 1 to %d expected\n", dir, tracks.size(), NB_SON);
+        return 1;
+    }
+    SD.setTiming(open_us, byte_ns);
+
+    Histogram histogram("trigger_to_sound_microseconds", "Trigger to first decoded sample", LATENCY_BOUNDS_US,
+                        sizeof(LATENCY_BOUNDS_US) / sizeof(LATENCY_BOUNDS_US[0]));
+    LatencyTrace latency(&histogram);
+    Pir pir(0, 0, PIR_PIN, PIR_SCENARIO::PLAY_ONCE_WHEN_MOVE);
+    pir.setMaxSound(tracks.size());
+    FileSource file_source;
+    WarmSource warm_source;
+    AudioFileSource& source = cold ? (AudioFileSource&)file_source : warm_source;
+    PLAYER_STATE player_state = PLAYER_STATE::STOPPED;
+
+    if (csv) {
+        printf("trigger,track,start_us,pick_us,path_us,setup_us,total_us,bytes\n");
+    } else {
+        printf("sd image       %s, %zu tracks\n", dir, tracks.size());
+        printf("sd timing      open %u us, %u ns/byte\n", open_us, byte_ns);
+        printf("source         %s\n", cold ? "cold, opened at the trigger" : "warm, prepared between triggers");
+        printf("\n%8s %6s %10s %10s %10s %10s %10s %8s\n", "trigger", "track", "start_us", "pick_us",
+               "path_us", "setup_us", "total_us", "bytes");
+    }
+
+    std::vector<uint32_t> totals;
+    uint32_t over_target = 0;
+    for (uint32_t n = 0; n < triggers; n++) {
+        if (!cold) {
+            warm_source.prepare(tracks[pir.getNextTrack()].c_str());
+        }
+        shim::setPin(PIR_PIN, LOW);
+        shim::advanceMillis(100);
+        shim::setPin(PIR_PIN, HIGH);
+        while (!pir.isTriggered(millis(), player_state)) {
+            shim::advanceMillis(1);
+        }
+
+        // startTrack() and setUpTrack()
+        latency.begin();
+        latency.mark(LATENCY_STAGE::LATENCY_START);
+        pir.pickMusic();
+        latency.mark(LATENCY_STAGE::LATENCY_PICK);
+        uint8_t track = pir.getCurrentTrack();
+        char path[64];
+        strncpy(path, tracks[track].c_str(), sizeof(path) - 1);
+        path[sizeof(path) - 1] = '\0';
+        latency.mark(LATENCY_STAGE::LATENCY_PATH);
+        source.open(path);
+        latency.mark(LATENCY_STAGE::LATENCY_SETUP);
+        size_t bytes = readFirstFrame(source);
+        if (bytes == 0) {
+            latency.cancel();
+            fprintf(stderr, "%s: no MP3 frame\n", path);
+            return 1;
+        }
+        latency.end();
+
+        totals.push_back(latency.total());
+        if (target_us && latency.total() > target_us) over_target++;
+        printf(csv ? "%u,%u,%u,%u,%u,%u,%u,%zu\n" : "%8u %6u %10u %10u %10u %10u %10u %8zu\n", n, track,
+               latency.at(LATENCY_STAGE::LATENCY_START), latency.at(LATENCY_STAGE::LATENCY_PICK),
+               latency.at(LATENCY_STAGE::LATENCY_PATH), latency.at(LATENCY_STAGE::LATENCY_SETUP),
+               latency.total(), bytes);
+
+        // "MP3 done", decoder->stop() closes the source
+        source.close();
+        player_state = PLAYER_STATE::STOPPED;
+        pir.rearm(millis());
+    }
+
+    if (!csv) {
+        printf("\nlatency        min %u us, median %u us, p95 %u us, max %u us\n", percentile(totals, 0),
+               percentile(totals, 50), percentile(totals, 95), percentile(totals, 100));
+        if (target_us) {
+            printf("target         %u us, %u of %u triggers over\n", target_us, over_target, triggers);
+        }
+    }
+    return over_target ? 1 : 0;
+}
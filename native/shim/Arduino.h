@@ -0,0 +1,144 @@
+#pragma once
+
+// Minimal Arduino HAL for the [env:native] host build.
+// Only what the sensor classes and the loop() timekeeping use is provided.
+// Time is virtual: millis()/micros() only move when delay(), pulseIn() or
+// shim::advanceMillis() are called, so runs are fully deterministic.
+// Interrupt handlers run from inside those calls, at the virtual time of
+// the edge.
+
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#define LOW 0x0
+#define HIGH 0x1
+
+#define INPUT 0x00
+#define OUTPUT 0x01
+#define INPUT_PULLUP 0x02
+
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+// As on the ESP8266, GPIO16 (D0) has no interrupt
+#define NOT_AN_INTERRUPT -1
+#define EXTERNAL_NUM_INTERRUPTS 16
+#define digitalPinToInterrupt(p) (((p) < EXTERNAL_NUM_INTERRUPTS) ? (p) : NOT_AN_INTERRUPT)
+
+#define IRAM_ATTR
+
+enum : uint8_t { D0 = 16, D1 = 5, D2 = 4, D3 = 0, D4 = 2, D5 = 14, D6 = 12, D7 = 13, D8 = 15 };
+#define LED_BUILTIN 2
+
+#define F(string_literal) (string_literal)
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t val);
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+unsigned long pulseIn(uint8_t pin, uint8_t state, unsigned long timeout = 1000000L);
+
+void attachInterruptArg(uint8_t pin, void (*handler)(void*), void* arg, int mode);
+void detachInterrupt(uint8_t pin);
+inline void noInterrupts() {}
+inline void interrupts() {}
+inline void yield() {}
+
+class HardwareSerial
+{
+public:
+    void begin(unsigned long baud) { (void)baud; }
+    size_t print(const char* str);
+    size_t print(int value);
+    size_t println(const char* str = "");
+    size_t println(int value);
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+    size_t write(const uint8_t* buffer, size_t len) { return write_((const char*)buffer, len); }
+    // Never full, the host has no UART FIFO to wait for
+    int availableForWrite() { return 128; }
+
+    // Serial output is discarded unless echo is enabled, so benchmarks pay
+    // for the formatting but not for the terminal.
+    void setEcho(bool echo) { echo_ = echo; }
+
+private:
+    size_t write_(const char* str, size_t len);
+
+    bool echo_ = false;
+};
+
+extern HardwareSerial Serial;
+
+enum rst_reason {
+    REASON_DEFAULT_RST = 0,
+    REASON_WDT_RST = 1,
+    REASON_EXCEPTION_RST = 2,
+    REASON_SOFT_WDT_RST = 3,
+    REASON_SOFT_RESTART = 4,
+    REASON_DEEP_SLEEP_AWAKE = 5,
+    REASON_EXT_SYS_RST = 6
+};
+
+struct rst_info
+{
+    uint32_t reason;
+};
+
+// RTC user memory (512 bytes, offsets in 4-byte blocks) and reset reason,
+// both kept across shim::reset() like across a soft reset.
+class EspClass
+{
+public:
+    bool rtcUserMemoryRead(uint32_t offset, uint32_t* data, size_t size);
+    bool rtcUserMemoryWrite(uint32_t offset, uint32_t* data, size_t size);
+    rst_info* getResetInfoPtr() { return &reset_info_; }
+
+    void setResetReason(uint32_t reason) { reset_info_.reason = reason; }
+
+private:
+    uint32_t rtc_[128] = {0};
+    rst_info reset_info_ = {REASON_DEFAULT_RST};
+};
+
+extern EspClass ESP;
+
+namespace shim {
+
+constexpr uint8_t NB_PINS = 17;
+
+void reset();
+void advanceMillis(uint32_t ms);
+void advanceMicros(uint64_t us);
+uint64_t nowMicros();
+
+void setPin(uint8_t pin, int level);
+int getPin(uint8_t pin);
+
+// Echo duration pulseIn() reports on its next call for that pin,
+// 0 meaning "no echo" (the call then burns its whole timeout).
+void setPulse(uint8_t pin, uint32_t duration_us);
+
+// Wires a rangefinder: every HIGH to LOW edge on trig_pin raises echo_pin
+// ECHO_LATENCY_US later for its setPulse() duration, firing the attached
+// interrupt on both edges. A 0 duration gives no echo at all.
+constexpr uint32_t ECHO_LATENCY_US = 450;
+void linkEcho(uint8_t trig_pin, uint8_t echo_pin);
+
+// Called every time virtual time moves, so a scenario can drive the pins
+// even from inside a blocking delay() or pulseIn().
+typedef void (*InputHook)(uint64_t now_us);
+void setInputHook(InputHook hook);
+
+}  // namespace shim
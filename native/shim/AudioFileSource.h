@@ -0,0 +1,23 @@
+#pragma once
+
+// Base class of the ESP8266Audio sources, for the [env:native] host build.
+// Same virtuals as the library, without the metadata/status callbacks.
+
+#include <Arduino.h>
+
+class AudioFileSource
+{
+public:
+    AudioFileSource() = default;
+    virtual ~AudioFileSource() = default;
+
+    virtual bool open(const char* filename) { (void)filename; return false; }
+    virtual uint32_t read(void* data, uint32_t len) { (void)data; (void)len; return 0; }
+    virtual uint32_t readNonBlock(void* data, uint32_t len) { return read(data, len); }
+    virtual bool seek(int32_t pos, int dir) { (void)pos; (void)dir; return false; }
+    virtual bool close() { return false; }
+    virtual bool isOpen() { return false; }
+    virtual uint32_t getSize() { return 0; }
+    virtual uint32_t getPos() { return 0; }
+    virtual bool loop() { return true; }
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+// In-memory SD card for the [env:native] host build. Files live in a flat
+// map keyed by absolute path, which is all the firmware ever uses.
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <Arduino.h>
+
+#define FILE_READ 0x01
+#define FILE_WRITE 0x02
+#define SD_SCK_MHZ(maxMhz) (1000000UL * (maxMhz))
+
+class File
+{
+public:
+    File() = default;
+
+    explicit operator bool() const { return data_ != nullptr || is_dir_; }
+
+    size_t write(const uint8_t* buf, size_t size);
+    size_t write(uint8_t c) { return write(&c, 1); }
+    int read();
+    int read(uint8_t* buf, size_t size);
+    int available() const;
+    bool seek(uint32_t pos);
+    uint32_t position() const { return pos_; }
+    uint32_t size() const;
+    void flush() {}
+    void close();
+
+    const char* name() const;
+    const char* fullName() const { return path_.c_str(); }
+    bool isDirectory() const { return is_dir_; }
+    File openNextFile();
+
+private:
+    friend class SDClass;
+
+    std::string path_;
+    std::shared_ptr<std::vector<uint8_t>> data_;
+    uint32_t pos_ = 0;
+    bool is_dir_ = false;
+    size_t dir_cursor_ = 0;
+};
+
+class SDClass
+{
+public:
+    bool begin(uint8_t csPin, uint32_t cfg = SD_SCK_MHZ(4));
+    File open(const char* path, uint8_t mode = FILE_READ);
+    File open(const std::string& path, uint8_t mode = FILE_READ) { return open(path.c_str(), mode); }
+    bool exists(const char* path) const;
+    bool remove(const char* path);
+    bool remove(const std::string& path) { return remove(path.c_str()); }
+
+    // Host-side helpers, not part of the Arduino API.
+    void format();
+    bool loadImage(const char* host_dir);
+    // Virtual time each file open() and each byte read cost, none by
+    // default. Stands for the SPI bus of the module, see latency/.
+    void setTiming(uint32_t open_us, uint32_t read_ns_per_byte);
+
+private:
+    friend class File;
+
+    std::map<std::string, std::shared_ptr<std::vector<uint8_t>>> files_;
+    uint32_t open_us_ = 0;
+    uint32_t read_ns_per_byte_ = 0;
+};
+
+extern SDClass SD;
@@ -0,0 +1,312 @@
+#include <Arduino.h>
+#include <SD.h>
+
+#include <dirent.h>
+
+HardwareSerial Serial;
+EspClass ESP;
+SDClass SD;
+
+namespace {
+
+uint64_t now_us = 0;
+int pin_levels[shim::NB_PINS] = {0};
+uint32_t pulse_durations_us[shim::NB_PINS] = {0};
+shim::InputHook input_hook = nullptr;
+
+constexpr uint8_t NO_PIN = 0xFF;
+uint8_t echo_links[shim::NB_PINS];
+uint64_t echo_rise_us[shim::NB_PINS] = {0};
+uint64_t echo_fall_us[shim::NB_PINS] = {0};
+uint8_t pending_edges = 0;
+
+void (*isr_handlers[shim::NB_PINS])(void*) = {nullptr};
+void* isr_args[shim::NB_PINS] = {nullptr};
+
+void setLevel(uint8_t pin, int level) {
+    bool changed = pin_levels[pin] != level;
+    pin_levels[pin] = level;
+    if (changed && isr_handlers[pin]) isr_handlers[pin](isr_args[pin]);
+}
+
+// Fires the echo edges due before target_us, in time order
+void runEchoes(uint64_t target_us) {
+    while (pending_edges) {
+        uint8_t pin = NO_PIN;
+        uint64_t at = target_us + 1;
+        for (uint8_t i = 0; i < shim::NB_PINS; i++) {
+            uint64_t next = echo_rise_us[i] ? echo_rise_us[i] : echo_fall_us[i];
+            if (next && next < at) {
+                at = next;
+                pin = i;
+            }
+        }
+        if (pin == NO_PIN) return;
+        now_us = at;
+        pending_edges--;
+        if (echo_rise_us[pin]) {
+            echo_rise_us[pin] = 0;
+            setLevel(pin, HIGH);
+        } else {
+            echo_fall_us[pin] = 0;
+            setLevel(pin, LOW);
+        }
+    }
+}
+
+}  // namespace
+
+void shim::reset() {
+    now_us = 0;
+    for (uint8_t i = 0; i < NB_PINS; i++) {
+        pin_levels[i] = LOW;
+        pulse_durations_us[i] = 0;
+        echo_links[i] = NO_PIN;
+        echo_rise_us[i] = 0;
+        echo_fall_us[i] = 0;
+        isr_handlers[i] = nullptr;
+        isr_args[i] = nullptr;
+    }
+    pending_edges = 0;
+    input_hook = nullptr;
+}
+
+void shim::advanceMillis(uint32_t ms) { advanceMicros((uint64_t)ms * 1000); }
+
+void shim::advanceMicros(uint64_t us) {
+    uint64_t target_us = now_us + us;
+    runEchoes(target_us);
+    now_us = target_us;
+    if (input_hook) input_hook(now_us);
+}
+
+uint64_t shim::nowMicros() { return now_us; }
+
+void shim::setPin(uint8_t pin, int level) {
+    if (pin < NB_PINS) setLevel(pin, level);
+}
+
+int shim::getPin(uint8_t pin) { return pin < NB_PINS ? pin_levels[pin] : LOW; }
+
+void shim::setPulse(uint8_t pin, uint32_t duration_us) {
+    if (pin < NB_PINS) pulse_durations_us[pin] = duration_us;
+}
+
+void shim::linkEcho(uint8_t trig_pin, uint8_t echo_pin) {
+    if (trig_pin < NB_PINS && echo_pin < NB_PINS) echo_links[trig_pin] = echo_pin;
+}
+
+void shim::setInputHook(InputHook hook) {
+    input_hook = hook;
+    if (input_hook) input_hook(now_us);
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    (void)pin;
+    (void)mode;
+}
+
+int digitalRead(uint8_t pin) { return shim::getPin(pin); }
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+    if (pin >= shim::NB_PINS) return;
+    uint8_t echo = echo_links[pin];
+    if (echo != NO_PIN && val == LOW && pin_levels[pin] == HIGH && pulse_durations_us[echo]) {
+        if (echo_rise_us[echo]) pending_edges--;
+        if (echo_fall_us[echo]) pending_edges--;
+        echo_rise_us[echo] = now_us + shim::ECHO_LATENCY_US;
+        echo_fall_us[echo] = echo_rise_us[echo] + pulse_durations_us[echo];
+        pending_edges += 2;
+    }
+    pin_levels[pin] = val;
+}
+
+void attachInterruptArg(uint8_t pin, void (*handler)(void*), void* arg, int mode) {
+    (void)mode;
+    if (pin >= shim::NB_PINS) return;
+    isr_handlers[pin] = handler;
+    isr_args[pin] = arg;
+}
+
+void detachInterrupt(uint8_t pin) {
+    if (pin < shim::NB_PINS) isr_handlers[pin] = nullptr;
+}
+
+unsigned long millis() { return (unsigned long)(uint32_t)(now_us / 1000); }
+
+unsigned long micros() { return (unsigned long)(uint32_t)now_us; }
+
+void delay(unsigned long ms) { shim::advanceMillis(ms); }
+
+void delayMicroseconds(unsigned int us) { shim::advanceMicros(us); }
+
+unsigned long pulseIn(uint8_t pin, uint8_t state, unsigned long timeout) {
+    (void)state;
+    uint32_t duration = pin < shim::NB_PINS ? pulse_durations_us[pin] : 0;
+    if (duration == 0 || duration > timeout) {
+        shim::advanceMicros(timeout);
+        return 0;
+    }
+    shim::advanceMicros(duration);
+    return duration;
+}
+
+/********************************** Serial **********************************/
+
+size_t HardwareSerial::write_(const char* str, size_t len) {
+    if (echo_) fwrite(str, 1, len, stdout);
+    return len;
+}
+
+size_t HardwareSerial::print(const char* str) { return write_(str, strlen(str)); }
+
+size_t HardwareSerial::print(int value) { return printf("%d", value); }
+
+size_t HardwareSerial::println(const char* str) { return print(str) + write_("\r\n", 2); }
+
+size_t HardwareSerial::println(int value) { return print(value) + write_("\r\n", 2); }
+
+size_t HardwareSerial::printf(const char* format, ...) {
+    char buffer[256];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    if (len < 0) return 0;
+    return write_(buffer, std::min((size_t)len, sizeof(buffer) - 1));
+}
+
+/*********************************** ESP ************************************/
+
+// Same bounds as the core: offset + size within the 512 bytes
+bool EspClass::rtcUserMemoryRead(uint32_t offset, uint32_t* data, size_t size) {
+    if (offset * 4 + size > sizeof(rtc_) || size % 4) return false;
+    memcpy(data, rtc_ + offset, size);
+    return true;
+}
+
+bool EspClass::rtcUserMemoryWrite(uint32_t offset, uint32_t* data, size_t size) {
+    if (offset * 4 + size > sizeof(rtc_) || size % 4) return false;
+    memcpy(rtc_ + offset, data, size);
+    return true;
+}
+
+/************************************ SD ************************************/
+
+size_t File::write(const uint8_t* buf, size_t size) {
+    if (!data_) return 0;
+    if (pos_ + size > data_->size()) data_->resize(pos_ + size);
+    memcpy(data_->data() + pos_, buf, size);
+    pos_ += size;
+    return size;
+}
+
+int File::read() {
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+}
+
+int File::read(uint8_t* buf, size_t size) {
+    if (!data_) return -1;
+    size_t len = std::min(size, (size_t)available());
+    memcpy(buf, data_->data() + pos_, len);
+    pos_ += len;
+    if (SD.read_ns_per_byte_) shim::advanceMicros((uint64_t)len * SD.read_ns_per_byte_ / 1000);
+    return len;
+}
+
+int File::available() const { return data_ ? data_->size() - pos_ : 0; }
+
+bool File::seek(uint32_t pos) {
+    if (!data_ || pos > data_->size()) return false;
+    pos_ = pos;
+    return true;
+}
+
+uint32_t File::size() const { return data_ ? data_->size() : 0; }
+
+void File::close() {
+    data_.reset();
+    is_dir_ = false;
+}
+
+const char* File::name() const {
+    size_t slash = path_.find_last_of('/');
+    return path_.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+}
+
+File File::openNextFile() {
+    File next;
+    if (!is_dir_) return next;
+    auto it = SD.files_.begin();
+    std::advance(it, std::min(dir_cursor_, SD.files_.size()));
+    if (it == SD.files_.end()) return next;
+    dir_cursor_++;
+    next.path_ = it->first;
+    next.data_ = it->second;
+    return next;
+}
+
+bool SDClass::begin(uint8_t csPin, uint32_t cfg) {
+    (void)csPin;
+    (void)cfg;
+    return true;
+}
+
+File SDClass::open(const char* path, uint8_t mode) {
+    File f;
+    std::string key = path[0] == '/' ? path : std::string("/") + path;
+    if (key == "/") {
+        f.path_ = key;
+        f.is_dir_ = true;
+        return f;
+    }
+    auto it = files_.find(key);
+    if (it == files_.end()) {
+        if (mode != FILE_WRITE) return f;
+        it = files_.emplace(key, std::make_shared<std::vector<uint8_t>>()).first;
+    }
+    f.path_ = key;
+    f.data_ = it->second;
+    if (mode == FILE_WRITE) f.pos_ = f.data_->size();
+    if (open_us_) shim::advanceMicros(open_us_);
+    return f;
+}
+
+bool SDClass::exists(const char* path) const {
+    std::string key = path[0] == '/' ? path : std::string("/") + path;
+    return files_.count(key) != 0;
+}
+
+bool SDClass::remove(const char* path) {
+    std::string key = path[0] == '/' ? path : std::string("/") + path;
+    return files_.erase(key) != 0;
+}
+
+void SDClass::format() { files_.clear(); }
+
+void SDClass::setTiming(uint32_t open_us, uint32_t read_ns_per_byte) {
+    open_us_ = open_us;
+    read_ns_per_byte_ = read_ns_per_byte;
+}
+
+bool SDClass::loadImage(const char* host_dir) {
+    DIR* dir = opendir(host_dir);
+    if (!dir) return false;
+    while (struct dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] == '.') continue;
+        std::string host_path = std::string(host_dir) + "/" + entry->d_name;
+        FILE* in = fopen(host_path.c_str(), "rb");
+        if (!in) continue;
+        auto data = std::make_shared<std::vector<uint8_t>>();
+        uint8_t buffer[4096];
+        size_t len;
+        while ((len = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+            data->insert(data->end(), buffer, buffer + len);
+        }
+        fclose(in);
+        files_[std::string("/") + entry->d_name] = data;
+    }
+    closedir(dir);
+    return true;
+}
@@ -0,0 +1,29 @@
+#include "loop_model.hpp"
+
+LoopModel::LoopModel(Capteur* capteur, uint32_t track_duration_ms)
+    : capteur(capteur), track_duration_ms(track_duration_ms) {}
+
+void LoopModel::iteration() {
+    uint64_t now_ms = horloge.tick(millis());
+    digitalWrite(D2, player_state == PLAYER_STATE::PLAYING ? HIGH : LOW);
+
+    PLAYER_STATE previous_state = player_state;
+    bool triggered = capteur->isTriggered(now_ms, player_state);
+    if (!triggered && previous_state == PLAYER_STATE::PLAYING && player_state != PLAYER_STATE::PLAYING) {
+        // Stopped by the capteur itself (button released)
+        capteur->rearm(now_ms);
+    }
+    if (triggered) {
+        if (player_state != PLAYER_STATE::PLAYING && player_state != PLAYER_STATE::PAUSED) {
+            capteur->pickMusic();
+            track_end_ms = millis() + track_duration_ms;
+            trigger_ms.push_back(millis());
+        }
+        if ((int32_t)(millis() - track_end_ms) < 0) {
+            player_state = PLAYER_STATE::PLAYING;
+        } else {
+            player_state = PLAYER_STATE::STOPPED;
+            capteur->rearm(now_ms);
+        }
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <Arduino.h>
+
+#include "capteur.hpp"
+#include "horloge.hpp"
+
+// Host model of the sensor half of loop(): clock, LED, isTriggered, track
+// start and the "MP3 done" transition of handleTrack, which rearms the
+// capteur. Playback is modelled as a fixed duration instead of a decoder.
+struct LoopModel
+{
+    explicit LoopModel(Capteur* capteur, uint32_t track_duration_ms = 3000);
+
+    void iteration();
+
+    std::unique_ptr<Capteur> capteur;
+    Horloge horloge;
+    PLAYER_STATE player_state = PLAYER_STATE::STOPPED;
+    uint32_t track_duration_ms;
+    uint32_t track_end_ms = 0;
+    std::vector<uint32_t> trigger_ms;
+};
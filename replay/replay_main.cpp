@@ -0,0 +1,193 @@
+// Host replayer for sensor traces recorded with record_trace (see trace.hpp),
+// built by [env:native_replay].
+//
+//   pio run -e native_replay && .pio/build/native_replay/program trace.bin
+//       [-s scenario] [-p loop_period_us] [-t track_duration_ms] [--csv]
+//
+// The trace drives the shim pins and echoes on the virtual clock while the
+// recorded Capteur runs inside the loop() model, as fast as the host allows.
+// Replayed track starts are matched against the ones the module recorded.
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <Arduino.h>
+
+#include "bouton.hpp"
+#include "infrarouge.hpp"
+#include "loop_model.hpp"
+#include "pir.hpp"
+#include "trace.hpp"
+#include "ultrason.hpp"
+
+namespace {
+
+constexpr uint8_t TRIG_PIN = D3;
+constexpr uint32_t TAIL_MS = 10000;
+constexpr uint32_t MATCH_WINDOW_MS = 5000;
+
+std::vector<TraceRecord> records;
+size_t next_record = 0;
+// Gets the delays of DELAY records, as the module's did after each sync
+Capteur* replayed = nullptr;
+
+void traceHook(uint64_t now_us) {
+    while (next_record < records.size() &&
+           (uint64_t)records[next_record].timestamp_ms * 1000 <= now_us) {
+        const TraceRecord& record = records[next_record++];
+        if (record.kind == TRACE_KIND::PIN_LEVEL) {
+            shim::setPin(record.pin, record.level);
+        } else if (record.kind == TRACE_KIND::ECHO) {
+            shim::setPulse(record.pin, record.echo_us);
+        } else if (record.kind == TRACE_KIND::DELAY && replayed) {
+            replayed->updateDelay(record.delay_min, record.delay_sec);
+        }
+    }
+}
+
+bool loadTrace(const char* path, TraceHeader& header) {
+    FILE* in = fopen(path, "rb");
+    if (!in) return false;
+    std::vector<uint8_t> raw;
+    uint8_t buffer[4096];
+    size_t len;
+    while ((len = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+        raw.insert(raw.end(), buffer, buffer + len);
+    }
+    fclose(in);
+
+    if (!decodeTraceHeader(raw.data(), raw.size(), header)) return false;
+    size_t pos = TRACE_HEADER_SIZE;
+    uint32_t last_ms = 0;
+    TraceRecord record;
+    while (pos < raw.size()) {
+        size_t used = decodeTraceRecord(raw.data() + pos, raw.size() - pos, last_ms, record);
+        if (used == 0) break;  // truncated tail, e.g. power cut before flush()
+        records.push_back(record);
+        pos += used;
+    }
+    return true;
+}
+
+Capteur* makeCapteur(const TraceHeader& header) {
+    switch (header.capteur_type) {
+        case CAPTEUR_TYPE::PIR:
+            return new Pir(header.delay_min, header.delay_sec, D0, header.scenario);
+        case CAPTEUR_TYPE::BOUTON:
+            return new Bouton(header.delay_min, header.delay_sec, D0, header.scenario);
+        case CAPTEUR_TYPE::INFRAROUGE:
+            return new Infrarouge(header.delay_min, header.delay_sec, D0, header.scenario);
+        case CAPTEUR_TYPE::ULTRASON:
+            return new Ultrason(header.delay_min, header.delay_sec, D0, header.scenario, TRIG_PIN,
+                                header.min_distance, header.time_within_minimum_sec,
+                                header.time_within_minimum_sec_2);
+        default:
+            return nullptr;
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const char* path = nullptr;
+    int scenario_override = -1;
+    uint32_t loop_period_us = 1000;
+    uint32_t track_duration_ms = 3000;
+    bool csv = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-s" && i + 1 < argc) {
+            scenario_override = atoi(argv[++i]);
+        } else if (arg == "-p" && i + 1 < argc) {
+            loop_period_us = strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "-t" && i + 1 < argc) {
+            track_duration_ms = strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--csv") {
+            csv = true;
+        } else {
+            path = argv[i];
+        }
+    }
+    if (!path || loop_period_us == 0) {
+        fprintf(stderr, "usage: %s trace.bin [-s scenario] [-p loop_period_us] "
+                        "[-t track_duration_ms] [--csv]\n", argv[0]);
+        return 2;
+    }
+
+    TraceHeader header;
+    if (!loadTrace(path, header)) {
+        fprintf(stderr, "%s: not a version 1 to %d sensor trace\n", path, TRACE_VERSION);
+        return 1;
+    }
+    if (scenario_override >= 0) header.scenario = scenario_override;
+
+    std::vector<uint32_t> recorded_triggers;
+    for (const TraceRecord& record : records) {
+        if (record.kind == TRACE_KIND::TRIGGER) recorded_triggers.push_back(record.timestamp_ms);
+    }
+
+    shim::reset();
+    Capteur* capteur = makeCapteur(header);
+    if (!capteur) {
+        fprintf(stderr, "%s: unknown capteur type %d\n", path, header.capteur_type);
+        return 1;
+    }
+    LoopModel model(capteur, track_duration_ms);
+    model.capteur->setMaxSound(NB_SON);
+    replayed = model.capteur.get();
+
+    uint32_t first_ms = records.empty() ? 0 : records.front().timestamp_ms;
+    uint32_t end_ms = (records.empty() ? 0 : records.back().timestamp_ms) + TAIL_MS;
+    shim::advanceMillis(first_ms);
+    shim::setInputHook(traceHook);
+
+    uint64_t iterations = 0;
+    auto start = std::chrono::steady_clock::now();
+    while (millis() < end_ms) {
+        model.iteration();
+        shim::advanceMicros(loop_period_us);
+        iterations++;
+    }
+    double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double virtual_s = (end_ms - first_ms) / 1000.0;
+
+    if (csv) {
+        printf("recorded_ms,replayed_ms,delta_ms\n");
+    } else {
+        printf("trace          %s (capteur %d, scenario %d)\n", path, header.capteur_type,
+               header.scenario);
+        printf("records        %zu over %.1f s\n", records.size(), virtual_s);
+        printf("iterations     %llu, %.1f ns/iter\n", (unsigned long long)iterations,
+               iterations ? wall_s * 1e9 / iterations : 0.0);
+        printf("speedup        x%.0f\n", wall_s > 0 ? virtual_s / wall_s : 0.0);
+        printf("triggers       recorded %zu, replayed %zu\n", recorded_triggers.size(),
+               model.trigger_ms.size());
+        printf("\n%12s %12s %10s\n", "recorded_ms", "replayed_ms", "delta_ms");
+    }
+
+    // Both lists are sorted: walk them together, pairing triggers that are
+    // less than MATCH_WINDOW_MS apart and reporting the rest as missed/extra.
+    size_t r = 0, p = 0;
+    while (r < recorded_triggers.size() || p < model.trigger_ms.size()) {
+        bool has_r = r < recorded_triggers.size();
+        bool has_p = p < model.trigger_ms.size();
+        int64_t delta = has_r && has_p ? (int64_t)model.trigger_ms[p] - recorded_triggers[r] : 0;
+        if (has_r && has_p && llabs(delta) < MATCH_WINDOW_MS) {
+            printf(csv ? "%u,%u,%lld\n" : "%12u %12u %10lld\n", recorded_triggers[r],
+                   model.trigger_ms[p], (long long)delta);
+            r++;
+            p++;
+        } else if (has_r && (!has_p || delta > 0)) {
+            if (csv) printf("%u,,\n", recorded_triggers[r]);
+            else printf("%12u %12s %10s\n", recorded_triggers[r], "-", "missed");
+            r++;
+        } else {
+            if (csv) printf(",%u,\n", model.trigger_ms[p]);
+            else printf("%12s %12u %10s\n", "-", model.trigger_ms[p], "extra");
+            p++;
+        }
+    }
+    return 0;
+}
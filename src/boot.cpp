@@ -0,0 +1,91 @@
+#include "boot.hpp"
+
+#include "fmt.hpp"
+#include "log.hpp"
+
+static const char* PHASE_NAMES_[NB_BOOT_PHASES] = {"serial", "wifi", "sd", "fetch_local",
+                                                   "capteurs", "setup", "sync", "ntp"};
+
+// rst_reason order, as ESP.getResetReason() words them
+static const char* RESET_REASON_NAMES_[] = {"Power On", "Hardware Watchdog", "Exception",
+                                            "Software Watchdog", "Software/System restart",
+                                            "Deep-Sleep Wake", "External System"};
+
+const char* resetReasonName(const uint32_t& reason) {
+    return reason < sizeof(RESET_REASON_NAMES_) / sizeof(RESET_REASON_NAMES_[0]) ? RESET_REASON_NAMES_[reason]
+                                                                                 : "Unknown";
+}
+
+void BootTimes::begin() {
+    const rst_info* info = ESP.getResetInfoPtr();
+    uint32_t reason = info ? info->reason : (uint32_t)REASON_DEFAULT_RST;
+
+    ESP.rtcUserMemoryRead(BOOT_RTC_OFFSET, (uint32_t*)&previous_, sizeof(previous_));
+    // Random after a power-on
+    has_previous_ = previous_.magic == BOOT_RTC_MAGIC && reason != REASON_DEFAULT_RST;
+
+    current_.magic = BOOT_RTC_MAGIC;
+    current_.reset_reason = reason;
+    for (uint8_t i = 0; i < NB_BOOT_PHASES; i++) {
+        current_.start_ms[i] = 0;
+        current_.duration_ms[i] = BOOT_PENDING;
+    }
+    ESP.rtcUserMemoryWrite(BOOT_RTC_OFFSET, (uint32_t*)&current_, sizeof(current_));
+}
+
+void BootTimes::start(const BOOT_PHASE& phase) {
+    if (current_.duration_ms[phase] != BOOT_PENDING) {
+        return;
+    }
+    current_.start_ms[phase] = millis();
+}
+
+void BootTimes::end(const BOOT_PHASE& phase) {
+    if (current_.duration_ms[phase] != BOOT_PENDING) {
+        return;
+    }
+    current_.duration_ms[phase] = millis() - current_.start_ms[phase];
+    ESP.rtcUserMemoryWrite(BOOT_RTC_OFFSET, (uint32_t*)&current_, sizeof(current_));
+}
+
+void BootTimes::report() const {
+    printLog(__func__, LOG_INFO, "Reset reason: %s", resetReasonName(current_.reset_reason));
+    if (!has_previous_) {
+        return;
+    }
+    for (uint8_t i = 0; i < NB_BOOT_PHASES; i++) {
+        if (previous_.duration_ms[i] == BOOT_PENDING) {
+            printLog(__func__, LOG_INFO, "Previous boot: %s not done", PHASE_NAMES_[i]);
+        } else {
+            printLog(__func__, LOG_INFO, "Previous boot: %s at %u ms, %u ms", PHASE_NAMES_[i],
+                     previous_.start_ms[i], previous_.duration_ms[i]);
+        }
+    }
+}
+
+// One boot's object, left open for "previous"
+size_t BootTimes::json_(const Times& times, char* out, const size_t& size, size_t len) {
+    len = appendFormat(out, size, len, "{\"reset_reason\":\"%s\",\"phases\":{", resetReasonName(times.reset_reason));
+    for (uint8_t i = 0; i < NB_BOOT_PHASES; i++) {
+        if (times.duration_ms[i] == BOOT_PENDING) {
+            len = appendFormat(out, size, len, "%s\"%s\":null", i ? "," : "", PHASE_NAMES_[i]);
+        } else {
+            len = appendFormat(out, size, len, "%s\"%s\":{\"start_ms\":%u,\"duration_ms\":%u}", i ? "," : "",
+                          PHASE_NAMES_[i], times.start_ms[i], times.duration_ms[i]);
+        }
+    }
+    return appendFormat(out, size, len, "}");
+}
+
+size_t BootTimes::json(char* out, const size_t& size) const {
+    out[0] = '\0';
+    size_t len = json_(current_, out, size, 0);
+    len = appendFormat(out, size, len, ",\"previous\":");
+    if (has_previous_) {
+        len = json_(previous_, out, size, len);
+        len = appendFormat(out, size, len, "}");
+    } else {
+        len = appendFormat(out, size, len, "null");
+    }
+    return appendFormat(out, size, len, "}");
+}
@@ -1,31 +1,31 @@
 #include "bouton.hpp"
 
+#define BOUTON_DEBOUNCE_MS 50
+
 Bouton::Bouton(const int& delayMin, const int& delaySec, const uint8_t& pin, const int& scenario)
 :Capteur(delayMin, delaySec, pin, scenario)
 {
+    input_.begin(pin_);
 }
 
 Bouton::~Bouton()
 {
 }
 
-bool Bouton::isTriggered(uint32_t &minutes_since_act, uint8_t &seconds_since_act, uint32_t seconds_since_boot_act_timestamp, const uint32_t &seconds_since_boot, PLAYER_STATE &player_state) {
+bool Bouton::isTriggered(const uint64_t &now_ms, PLAYER_STATE &player_state) {
+    input_.update();
+
     switch (scenario_)
     {
     case BOUTON_SCENARIO::PLAY_AND_RESTART:
+        // Acts on the press edge, holding the button does nothing more
         if (player_state == PLAYER_STATE::PLAYING) {
-            if (digitalRead(pin_)) {
-                while (digitalRead(pin_)) {
-                    delay(10);
-                }
+            if (pressed_(now_ms)) {
                 player_state = PLAYER_STATE::STOPPED;
             }
             return true;
         }
-        else if (digitalRead(pin_)){
-            while (digitalRead(pin_)) {
-                delay(10);
-            }
+        else if (pressed_(now_ms)){
             return true;
         }
         else {
@@ -34,13 +34,11 @@ bool Bouton::isTriggered(uint32_t &minutes_since_act, uint8_t &seconds_since_act
         break;
 
     case BOUTON_SCENARIO::PLAY_WHEN_PRESSED_AND_RESUME:
-        if (digitalRead(pin_)) {
+        if (input_.high()) {
             return true;
         }
         else {
             if (player_state == PLAYER_STATE::PLAYING) {
-                seconds_since_act = 0;
-                minutes_since_act = 0;
                 player_state = PLAYER_STATE::PAUSED;
             }
             return false;
@@ -48,13 +46,11 @@ bool Bouton::isTriggered(uint32_t &minutes_since_act, uint8_t &seconds_since_act
         break;
 
     case BOUTON_SCENARIO::PLAY_WHEN_PRESSED_AND_RESTART:
-        if (digitalRead(pin_)) {
+        if (input_.high()) {
             return true;
         }
         else {
             if (player_state == PLAYER_STATE::PLAYING) {
-                seconds_since_act = 0;
-                minutes_since_act = 0;
                 player_state = PLAYER_STATE::STOPPED;
             }
             return false;
@@ -62,13 +58,11 @@ bool Bouton::isTriggered(uint32_t &minutes_since_act, uint8_t &seconds_since_act
         break;
 
     case BOUTON_SCENARIO::PLAY_WHEN_PRESSED_AND_RESTART_AFTER_DELAY:
-        if ((minutes_since_act * 60 + seconds_since_act >= delayMin_ * 60 + delaySec_) && digitalRead(pin_)) {
+        if (isReady_(now_ms) && input_.high()) {
             return true;
         }
         else {
             if (player_state == PLAYER_STATE::PLAYING) {
-                seconds_since_act = 0;
-                minutes_since_act = 0;
                 player_state = PLAYER_STATE::STOPPED;
             }
             return false;
@@ -80,3 +74,11 @@ bool Bouton::isTriggered(uint32_t &minutes_since_act, uint8_t &seconds_since_act
         break;
     }
 }
+
+bool Bouton::pressed_(const uint64_t& now_ms) {
+    if (!input_.rose() || now_ms - last_press_ms_ < BOUTON_DEBOUNCE_MS) {
+        return false;
+    }
+    last_press_ms_ = now_ms;
+    return true;
+}
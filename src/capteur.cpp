@@ -1,56 +1,117 @@
-#include "capteur.hpp"
-
-extern void printLog(const char* function, LOG_LEVEL level, const char* message, ...);
-
-Capteur::Capteur(const int& delayMin, const int& delaySec, const uint8_t& pin, const int& scenario)
-:delayMin_(delayMin), delaySec_(delaySec), pin_(pin), scenario_(scenario)
-{
-}
-
-void Capteur::setMaxSound(const uint8_t& max_sound) {
-    printLog(__func__, LOG_INFO, "start setMaxSound() max_sound: %d", max_sound);
-    max_sound_ = max_sound;
-    if (max_sound_ > 1) {
-        randomizeAll_();
-    }
-}
-
-void Capteur::randomizeAll_() { 
-    printLog(__func__, LOG_INFO, "start randomizeAll_()");
-    for (uint8_t i = 0; i < max_sound_; i++) {  // fill array
-        randomized_indexes_[i] = i;
-        Serial.printf("%d,", randomized_indexes_[i]);
-    }
-
-    for (uint8_t i = 0; i < max_sound_; i++) {  // shuffle array
-        uint8_t temp = randomized_indexes_[i];
-        uint8_t randomIndex = rand() % max_sound_;
-
-        randomized_indexes_[i] = randomized_indexes_[randomIndex];
-        randomized_indexes_[randomIndex] = temp;
-    }
-    printLog(__func__, LOG_INFO, "randomized_indexes_ : ");
-    for (uint8_t i = 0; i < max_sound_; i++) {  // print array
-        Serial.printf("%d,", randomized_indexes_[i]);
-    }
-    Serial.println("");
-}
-
-void Capteur::pickMusic() {
-    printLog(__func__, LOG_INFO, "_max_sound: %d", max_sound_);
-    if (current_index_ == max_sound_ - 1) {
-        current_index_ = 0;
-        if (max_sound_ > 1) {
-            randomizeAll_();
-        }
-    }
-    else if (current_index_ < max_sound_ - 1) {
-        current_index_ ++;
-    }
-    printLog(__func__, LOG_INFO, "current_index_: %d", current_index_);
-}
-
-void Capteur::updateDelay(const int& delayMin, const int& delaySec) {
-    delayMin_ = delayMin;
-    delaySec_ = delaySec;
-}
+#include "capteur.hpp"
+
+Capteur::Capteur(const int& delayMin, const int& delaySec, const uint8_t& pin, const int& scenario)
+:delay_ms_((delayMin * 60UL + delaySec) * 1000), pin_(pin), scenario_(scenario)
+{
+    for (uint8_t i = 0; i < NB_SON; i++) {
+        playlist_[i] = i;
+        randomized_indexes_[i] = i;
+    }
+}
+
+Capteur::~Capteur()
+{
+}
+
+void Capteur::setMaxSound(const uint8_t& max_sound) {
+    printLog(__func__, LOG_INFO, "start setMaxSound() max_sound: %d", max_sound);
+    max_sound_ = max_sound;
+    // Even a single track: the last shuffle may point past the new count
+    randomizeAll_();
+}
+
+void Capteur::setPlaylist(const uint8_t* tracks, const uint8_t& count) {
+    for (uint8_t i = 0; i < count && i < NB_SON; i++) {
+        playlist_[i] = tracks[i];
+    }
+    if (current_index_ >= count) {
+        current_index_ = 0;
+    }
+    setMaxSound(count);
+}
+
+void Capteur::randomizeAll_() { 
+    for (uint8_t i = 0; i < max_sound_; i++) {  // fill array
+        randomized_indexes_[i] = i;
+    }
+
+    for (uint8_t i = 0; i < max_sound_; i++) {  // shuffle array
+        uint8_t temp = randomized_indexes_[i];
+        uint8_t randomIndex = rand() % max_sound_;
+
+        randomized_indexes_[i] = randomized_indexes_[randomIndex];
+        randomized_indexes_[randomIndex] = temp;
+    }
+    if (LOG_DEBUG >= LOG_LEVEL_MIN) {
+        // "12,3,..." in one line, straight to Serial it blocked pickMusic()
+        char list[NB_SON * 3 + 1] = {0};
+        uint8_t len = 0;
+        for (uint8_t i = 0; i < max_sound_; i++) {  // print array
+            len += snprintf(list + len, sizeof(list) - len, "%d,", randomized_indexes_[i]);
+        }
+        printLog(__func__, LOG_DEBUG, "randomized_indexes_ : %s", list);
+    }
+}
+
+uint8_t Capteur::nextIndex() const {
+    if (current_index_ == max_sound_ - 1) {
+        return 0;
+    }
+    else if (current_index_ < max_sound_ - 1) {
+        return current_index_ + 1;
+    }
+    return current_index_;
+}
+
+void Capteur::pickMusic() {
+    printLog(__func__, LOG_DEBUG, "_max_sound: %d", max_sound_);
+    if (current_index_ == max_sound_ - 1) {
+        current_index_ = 0;
+        if (max_sound_ > 1) {
+            randomizeAll_();
+        }
+    }
+    else if (current_index_ < max_sound_ - 1) {
+        current_index_ ++;
+    }
+    printLog(__func__, LOG_DEBUG, "current_index_: %d", current_index_);
+}
+
+void Capteur::updateDelay(const int& delayMin, const int& delaySec) {
+    delay_ms_ = (delayMin * 60UL + delaySec) * 1000;
+}
+
+void Capteur::rearm(const uint64_t& now_ms) {
+    ready_at_ms_ = now_ms + delay_ms_;
+}
+
+void Capteur::updateHold(const uint16_t& hold_ms, const uint16_t& release_ms, const uint16_t& debounce_ms) {
+    hold_ms_ = hold_ms;
+    release_ms_ = release_ms;
+    debounce_ms_ = debounce_ms;
+}
+
+bool Capteur::whilePresent_(const uint64_t& now_ms, const bool& present, const bool& can_start, const uint16_t& default_release_ms) {
+    if (present) {
+        if (!present_) {
+            present_since_ms_ = now_ms;
+        }
+        last_present_ms_ = now_ms;
+    }
+    present_ = present;
+
+    if (!running_) {
+        if (can_start && present_ && now_ms - present_since_ms_ >= debounce_ms_) {
+            running_ = true;
+            running_since_ms_ = now_ms;
+        }
+        return running_;
+    }
+
+    uint16_t release_ms = release_ms_ > 0 ? release_ms_ : default_release_ms;
+    if (now_ms - running_since_ms_ < hold_ms_ || now_ms - last_present_ms_ < release_ms) {
+        return true;
+    }
+    running_ = false;
+    return false;
+}
@@ -0,0 +1,183 @@
+#include "catalogue.hpp"
+
+#include "log.hpp"
+
+void CatalogueParser::begin(TrackCallback on_track, void* ctx) {
+    *this = CatalogueParser();
+    on_track_ = on_track;
+    ctx_ = ctx;
+}
+
+void CatalogueParser::feed(const uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len && !done_ && !error_; i++) {
+        feed_(data[i]);
+    }
+}
+
+void CatalogueParser::feed_(char c) {
+    if (in_string_) {
+        if (unicode_digits_ > 0) {
+            uint8_t nibble;
+            if (c >= '0' && c <= '9') nibble = c - '0';
+            else if (c >= 'a' && c <= 'f') nibble = c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') nibble = c - 'A' + 10;
+            else {
+                error_ = true;
+                return;
+            }
+            unicode_ = (unicode_ << 4) | nibble;
+            if (--unicode_digits_ == 0) appendUtf8_(unicode_);
+        } else if (escape_) {
+            escape_ = false;
+            switch (c) {
+                case 'n': appendValue_('\n'); break;
+                case 't': appendValue_('\t'); break;
+                case 'r': appendValue_('\r'); break;
+                case 'b': appendValue_('\b'); break;
+                case 'f': appendValue_('\f'); break;
+                case 'u':
+                    unicode_ = 0;
+                    unicode_digits_ = 4;
+                    break;
+                default: appendValue_(c); break;  // \" \\ \/
+            }
+        } else if (c == '\\') {
+            escape_ = true;
+        } else if (c == '"') {
+            in_string_ = false;
+            if (string_is_key_) {
+                strncpy(key_, value_, CATALOGUE_KEY_SIZE - 1);
+                key_[CATALOGUE_KEY_SIZE - 1] = '\0';
+            } else {
+                onValue_();
+            }
+        } else {
+            appendValue_(c);
+        }
+        return;
+    }
+
+    if (in_scalar_) {
+        if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || c == '-' || c == '+' ||
+            c == '.' || c == 'E') {
+            appendValue_(c);
+            return;
+        }
+        endScalar_();
+    }
+
+    switch (c) {
+        case ' ':
+        case '\t':
+        case '\r':
+        case '\n':
+        case ':':
+            break;
+        case '{':
+            push_(true);
+            if (data_depth_ && depth_ == data_depth_ + 1) track_ = CatalogueTrack();
+            break;
+        case '[':
+            push_(false);
+            if (depth_ == 2 && strcmp(key_, "data") == 0) data_depth_ = depth_;
+            break;
+        case '}':
+            if (data_depth_ && depth_ == data_depth_ + 1 && on_track_) on_track_(track_, ctx_);
+            pop_();
+            break;
+        case ']':
+            if (depth_ == data_depth_) data_depth_ = 0;
+            pop_();
+            break;
+        case ',':
+            expecting_key_ = depth_ > 0 && topIsObject_();
+            break;
+        case '"':
+            in_string_ = true;
+            string_is_key_ = expecting_key_;
+            expecting_key_ = false;
+            value_len_ = 0;
+            value_[0] = '\0';
+            truncated_ = false;
+            break;
+        default:
+            in_scalar_ = true;
+            value_len_ = 0;
+            truncated_ = false;
+            appendValue_(c);
+            break;
+    }
+}
+
+void CatalogueParser::push_(bool is_object) {
+    if (depth_ >= CATALOGUE_MAX_DEPTH) {
+        error_ = true;
+        return;
+    }
+    containers_ = is_object ? (containers_ | (1 << depth_)) : (containers_ & ~(1 << depth_));
+    depth_++;
+    expecting_key_ = is_object;
+}
+
+void CatalogueParser::pop_() {
+    if (depth_ == 0) {
+        error_ = true;
+        return;
+    }
+    depth_--;
+    expecting_key_ = false;
+    if (depth_ == 0) done_ = true;
+}
+
+void CatalogueParser::endScalar_() {
+    in_scalar_ = false;
+    onValue_();
+}
+
+void CatalogueParser::onValue_() {
+    if (depth_ == 1) {
+        if (strcmp(key_, "is_error") == 0) success_ = strcmp(value_, "false") == 0;
+        else if (strcmp(key_, "delayMin") == 0) delay_min_ = atoi(value_);
+        else if (strcmp(key_, "delaySec") == 0) delay_sec_ = atoi(value_);
+        else if (strcmp(key_, "delayBefSec") == 0) delay_bef_sec_ = atoi(value_);
+        else if (strcmp(key_, "holdMs") == 0) hold_ms_ = atoi(value_);
+        else if (strcmp(key_, "releaseMs") == 0) release_ms_ = atoi(value_);
+        else if (strcmp(key_, "debounceMs") == 0) debounce_ms_ = atoi(value_);
+    } else if (data_depth_ && depth_ == data_depth_ + 1) {
+        // "s" has been seen both as a number and as a string, atoi takes both.
+        if (strcmp(key_, "id") == 0) track_.id = atoi(value_);
+        else if (strcmp(key_, "s") == 0) track_.size = atoi(value_);
+        else if (strcmp(key_, "t") == 0) {
+            // Cut, the title would lose its extension or end mid UTF-8 sequence
+            if (truncated_) {
+                printLog(__func__, LOG_ERROR, "Title longer than %d bytes: %s...", CATALOGUE_VALUE_SIZE - 1,
+                         value_);
+                error_ = true;
+                return;
+            }
+            memcpy(track_.title, value_, value_len_ + 1);
+        }
+    }
+}
+
+void CatalogueParser::appendValue_(char c) {
+    if (value_len_ < CATALOGUE_VALUE_SIZE - 1) {
+        value_[value_len_++] = c;
+        value_[value_len_] = '\0';
+    } else {
+        truncated_ = true;
+    }
+}
+
+void CatalogueParser::appendUtf8_(uint16_t code_point) {
+    if (code_point < 0x80) {
+        appendValue_(code_point);
+    } else if (code_point < 0x800) {
+        appendValue_(0xC0 | (code_point >> 6));
+        appendValue_(0x80 | (code_point & 0x3F));
+    } else {
+        appendValue_(0xE0 | (code_point >> 12));
+        appendValue_(0x80 | ((code_point >> 6) & 0x3F));
+        appendValue_(0x80 | (code_point & 0x3F));
+    }
+}
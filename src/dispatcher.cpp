@@ -0,0 +1,56 @@
+#include "dispatcher.hpp"
+
+Dispatcher::~Dispatcher() {
+    for (uint8_t i = 0; i < nb_postes_; i++) {
+        delete postes_[i].capteur;
+    }
+}
+
+bool Dispatcher::add(Capteur* capteur, const char* prefix, const uint8_t& priority) {
+    if (nb_postes_ == MAX_POSTES) {
+        printLog(__func__, LOG_ERROR, "%d postes max", MAX_POSTES);
+        delete capteur;
+        return false;
+    }
+    Poste& poste = postes_[nb_postes_++];
+    poste.capteur = capteur;
+    poste.prefix = prefix;
+    poste.priority = priority;
+    return true;
+}
+
+int8_t Dispatcher::poll(const uint64_t& now_ms, PLAYER_STATE& player_state) {
+    bool busy = player_state == PLAYER_STATE::PLAYING || player_state == PLAYER_STATE::PAUSED;
+    bool owner_triggered = false;
+    int8_t challenger = -1;
+    for (uint8_t i = 0; i < nb_postes_; i++) {
+        Poste& poste = postes_[i];
+        // No track matches its prefix, a trigger would play nothing
+        if (!poste.capteur->hasTracks()) {
+            continue;
+        }
+        if (i == owner_) {
+            owner_triggered = poste.capteur->isTriggered(now_ms, player_state);
+            continue;
+        }
+        PLAYER_STATE seen = busy ? PLAYER_STATE::STOPPED : player_state;
+        if (poste.capteur->isTriggered(now_ms, seen) &&
+            (challenger < 0 || poste.priority > postes_[challenger].priority)) {
+            challenger = i;
+        }
+    }
+
+    // Idle, the owner wins ties. Busy, the owner keeps the decoder (whether it
+    // still wants it or not) unless outranked.
+    bool outranks = challenger >= 0 && postes_[challenger].priority > postes_[owner_].priority;
+    bool take_over = challenger >= 0 && (outranks || (!busy && !owner_triggered));
+    if (!take_over) {
+        return owner_triggered ? owner_ : -1;
+    }
+    if (busy) {
+        printLog(__func__, LOG_INFO, "Poste %d takes over from poste %d", challenger, owner_);
+        player_state = PLAYER_STATE::STOPPED;
+    }
+    owner_ = challenger;
+    return challenger;
+}
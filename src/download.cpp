@@ -0,0 +1,39 @@
+#include "download.hpp"
+
+#include "log.hpp"
+
+void DownloadMetrics::log(const char* title) const {
+    printLog(__func__, LOG_INFO, "%s: %u bytes in %u ms (%u B/s)", title, bytes, duration_ms,
+             bytesPerSecond());
+    printLog(__func__, LOG_INFO, "stall %u ms, SD %u ms in %u writes, %u read timeouts",
+             stall_ms, sd_write_ms, sd_writes, read_timeouts);
+}
+
+void SectorWriter::begin(File* file, DownloadMetrics* metrics) {
+    file_ = file;
+    metrics_ = metrics;
+    used_ = 0;
+}
+
+bool SectorWriter::commit(const size_t& len) {
+    used_ += len;
+    metrics_->bytes += len;
+    if (used_ < sizeof(buffer_)) return true;
+    return write_();
+}
+
+bool SectorWriter::finish() {
+    if (used_ == 0) return true;
+    return write_();
+}
+
+bool SectorWriter::write_() {
+    uint32_t start = millis();
+    size_t written = file_->write(buffer_, used_);
+    metrics_->sd_write_ms += millis() - start;
+    metrics_->sd_writes++;
+    bool ok = written == used_;
+    used_ = 0;
+    if (!ok) printLog(__func__, LOG_ERROR, "SD write failed");
+    return ok;
+}
@@ -0,0 +1,124 @@
+#include "echo.hpp"
+
+// 0.034 cm/us there and back: 17 cm per ms of echo, 32-bit integer math
+// only (no FPU, and 64-bit division is a library call on the ESP8266)
+#define ECHO_CM_PER_MS 17
+
+EchoTimer::EchoTimer(const uint8_t& trig_pin, const uint8_t& echo_pin,
+                     const uint16_t& max_range_cm)
+    : trig_pin_(trig_pin),
+      echo_pin_(echo_pin),
+      max_echo_us_((uint32_t)max_range_cm * 1000 / ECHO_CM_PER_MS),
+      timeout_us_(max_echo_us_ + ECHO_START_MARGIN_US) {
+    pinMode(trig_pin_, OUTPUT);
+    digitalWrite(trig_pin_, LOW);
+    pinMode(echo_pin_, INPUT);
+    if (digitalPinToInterrupt(echo_pin_) != NOT_AN_INTERRUPT) {
+        attachInterruptArg(digitalPinToInterrupt(echo_pin_), onEdge_, this, CHANGE);
+        interrupt_ = true;
+    }
+}
+
+EchoTimer::~EchoTimer() {
+    if (interrupt_) {
+        detachInterrupt(digitalPinToInterrupt(echo_pin_));
+    }
+}
+
+void EchoTimer::start() {
+    if (busy_) {
+        return;
+    }
+    ready_ = false;
+    rising_seen_ = false;
+
+    // Clears the trigPin
+    digitalWrite(trig_pin_, LOW);
+    delayMicroseconds(2);
+    // Sets the trigPin on HIGH state for 10 micro seconds
+    digitalWrite(trig_pin_, HIGH);
+    delayMicroseconds(10);
+    trig_us_ = micros();
+    busy_ = interrupt_;
+    digitalWrite(trig_pin_, LOW);
+
+    if (!interrupt_) {
+        uint32_t duration = pulseIn(echo_pin_, HIGH, timeout_us_);
+        echo_us_ = duration > max_echo_us_ ? 0 : duration;
+        ready_ = true;
+    }
+}
+
+bool EchoTimer::available() {
+    noInterrupts();
+    if (busy_ && micros() - trig_us_ > timeout_us_) {
+        busy_ = false;
+        echo_us_ = 0;
+        ready_ = true;
+    }
+    bool ready = ready_;
+    ready_ = false;
+    interrupts();
+    return ready;
+}
+
+uint16_t EchoTimer::toCm(const uint32_t& echo_us) {
+    if (echo_us == 0) {
+        return ECHO_OUT_OF_RANGE;
+    }
+    return echo_us * ECHO_CM_PER_MS / 1000;
+}
+
+void EchoFilter::reset() {
+    count_ = 0;
+    next_ = 0;
+    ema_cm_x16_ = 0;
+}
+
+uint16_t EchoFilter::add(const uint32_t& echo_us) {
+    uint16_t cm = EchoTimer::toCm(echo_us);
+    samples_[next_] = cm > ECHO_MAX_RANGE_CM ? ECHO_MAX_RANGE_CM : cm;
+    next_ = (next_ + 1) % ECHO_FILTER_SIZE;
+    if (count_ < ECHO_FILTER_SIZE) {
+        count_++;
+    }
+
+    // Median of the window, insertion sort on a copy
+    uint16_t sorted[ECHO_FILTER_SIZE];
+    for (uint8_t i = 0; i < count_; i++) {
+        uint16_t value = samples_[i];
+        uint8_t j = i;
+        for (; j > 0 && sorted[j - 1] > value; j--) {
+            sorted[j] = sorted[j - 1];
+        }
+        sorted[j] = value;
+    }
+    uint16_t median = sorted[count_ / 2];
+
+    // EMA in 1/16 cm, reset on a real move so it only smooths jitter
+    int32_t median_x16 = (int32_t)median << 4;
+    int32_t delta = median_x16 - ema_cm_x16_;
+    if (count_ == 1 || delta > ECHO_FILTER_SNAP_CM * 16 || delta < -ECHO_FILTER_SNAP_CM * 16) {
+        ema_cm_x16_ = median_x16;
+    } else {
+        ema_cm_x16_ += delta >> ECHO_FILTER_EMA_SHIFT;
+    }
+    return distanceCm();
+}
+
+void IRAM_ATTR EchoTimer::onEdge_(void* arg) {
+    EchoTimer* self = static_cast<EchoTimer*>(arg);
+    if (!self->busy_) {
+        return;
+    }
+    uint32_t now = micros();
+    if (digitalRead(self->echo_pin_) == HIGH) {
+        self->rise_us_ = now;
+        self->rising_seen_ = true;
+    } else if (self->rising_seen_) {
+        uint32_t duration = now - self->rise_us_;
+        self->echo_us_ = duration > self->max_echo_us_ ? 0 : duration;
+        self->busy_ = false;
+        self->ready_ = true;
+    }
+}
@@ -0,0 +1,95 @@
+#include "edge.hpp"
+
+#include "log.hpp"
+#include "trace.hpp"
+
+bool IRAM_ATTR EdgeQueue::push(const EdgeEvent& event) {
+    uint8_t next = (head_ + 1) & (EDGE_QUEUE_SIZE - 1);
+    if (next == tail_) {
+        overflows_ = overflows_ + 1;
+        return false;
+    }
+    events_[head_] = event;
+    // The event is written before the consumer can see it
+    EDGE_BARRIER();
+    head_ = next;
+    return true;
+}
+
+bool EdgeQueue::pop(EdgeEvent& event) {
+    if (tail_ == head_) {
+        return false;
+    }
+    // Not read before head_ said it was there, nor freed before it is copied
+    EDGE_BARRIER();
+    event = events_[tail_];
+    EDGE_BARRIER();
+    tail_ = (tail_ + 1) & (EDGE_QUEUE_SIZE - 1);
+    return true;
+}
+
+EdgeInput::~EdgeInput() {
+    if (interrupt_) {
+        detachInterrupt(digitalPinToInterrupt(pin_));
+    }
+}
+
+void EdgeInput::begin(const uint8_t& pin) {
+    pin_ = pin;
+    level_ = digitalRead(pin_);
+    if (digitalPinToInterrupt(pin_) != NOT_AN_INTERRUPT) {
+        attachInterruptArg(digitalPinToInterrupt(pin_), onEdge_, this, CHANGE);
+        interrupt_ = true;
+    }
+}
+
+void EdgeInput::update() {
+    rose_ = false;
+    fell_ = false;
+    // Level before the first edge, once the trace has started
+    traceRecorder.pin(pin_, level_);
+
+    if (!interrupt_) {
+        EdgeEvent event;
+        event.timestamp_ms = millis();
+        event.level = digitalRead(pin_);
+        if (event.level != level_) {
+            apply_(event);
+        }
+        return;
+    }
+
+    EdgeEvent event;
+    while (queue_.pop(event)) {
+        apply_(event);
+    }
+    if (queue_.overflows() != overflows_seen_) {
+        // Edges were dropped, the replayed level may be stale
+        overflows_seen_ = queue_.overflows();
+        printLog(__func__, LOG_WARNING, "Edge queue overflow on pin %d", pin_);
+        event.timestamp_ms = millis();
+        event.level = digitalRead(pin_);
+        if (event.level != level_) {
+            apply_(event);
+        }
+    }
+}
+
+void EdgeInput::apply_(const EdgeEvent& event) {
+    if (event.level == HIGH) {
+        rose_ = true;
+    } else {
+        fell_ = true;
+    }
+    level_ = event.level;
+    last_edge_ms_ = event.timestamp_ms;
+    traceRecorder.pin(pin_, level_);
+}
+
+void IRAM_ATTR EdgeInput::onEdge_(void* arg) {
+    EdgeInput* self = static_cast<EdgeInput*>(arg);
+    EdgeEvent event;
+    event.timestamp_ms = millis();
+    event.level = digitalRead(self->pin_);
+    self->queue_.push(event);
+}
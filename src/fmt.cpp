@@ -0,0 +1,15 @@
+#include "fmt.hpp"
+
+size_t appendFormat(char* out, const size_t& size, size_t len, const char* format, ...) {
+    if (len + 1 >= size) {
+        return len;
+    }
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(out + len, size - len, format, args);
+    va_end(args);
+    if (written > 0) {
+        len += (size_t)written < size - len ? written : size - len - 1;
+    }
+    return len;
+}
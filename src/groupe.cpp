@@ -0,0 +1,106 @@
+#include "groupe.hpp"
+
+Groupe::Groupe(const int& delayMin, const int& delaySec, const uint8_t& votes_needed, const uint16_t& window_ms)
+:Capteur(delayMin, delaySec, 0, 0), votes_needed_(votes_needed), window_ms_(window_ms)
+{
+}
+
+Groupe::~Groupe()
+{
+    for (uint8_t i = 0; i < nb_capteurs_; i++) {
+        delete capteurs_[i];
+    }
+}
+
+bool Groupe::add(Capteur* capteur, const bool& expensive) {
+    if (nb_capteurs_ == GROUPE_MAX_CAPTEURS) {
+        printLog(__func__, LOG_ERROR, "Groupe full, %d capteurs max", GROUPE_MAX_CAPTEURS);
+        delete capteur;
+        return false;
+    }
+    // Cheap ones first, in the order they were added
+    uint8_t index = expensive ? nb_capteurs_ : nb_cheap_;
+    for (uint8_t i = nb_capteurs_; i > index; i--) {
+        capteurs_[i] = capteurs_[i - 1];
+    }
+    capteurs_[index] = capteur;
+    nb_capteurs_++;
+    if (!expensive) {
+        nb_cheap_++;
+    }
+    return true;
+}
+
+bool Groupe::isTriggered(const uint64_t &now_ms, PLAYER_STATE &player_state) {
+    // While playing, "once" scenarios answer true just to keep the track
+    // going: that is not a detection, it must not open a window.
+    bool playing = player_state == PLAYER_STATE::PLAYING;
+    uint8_t votes = 0;
+    for (uint8_t i = 0; i < nb_capteurs_; i++) {
+        voted_now_[i] = false;
+        // Remaining capteurs could still bring this many votes
+        uint8_t remaining = nb_capteurs_ - i;
+        bool decided = votes >= votes_needed_ || votes + remaining < votes_needed_;
+        // While playing every one is polled, whatever the vote: their
+        // state machines have to see the track start and stop.
+        if (i < nb_cheap_ || !decided || playing) {
+            if (capteurs_[i]->isTriggered(now_ms, player_state)) {
+                voted_now_[i] = true;
+                if (!playing) {
+                    voted_[i] = true;
+                    last_vote_ms_[i] = now_ms;
+                }
+            }
+        }
+        if (hasVote_(i, now_ms)) {
+            votes++;
+        }
+    }
+    if (votes < votes_needed_) {
+        return false;
+    }
+    if (!playing) {
+        // Votes are spent on this trigger
+        for (uint8_t i = 0; i < nb_capteurs_; i++) {
+            voted_[i] = false;
+        }
+    }
+    return true;
+}
+
+bool Groupe::hasVote_(const uint8_t& index, const uint64_t& now_ms) const {
+    if (voted_now_[index]) {
+        return true;
+    }
+    return window_ms_ > 0 && voted_[index] && now_ms - last_vote_ms_[index] <= window_ms_;
+}
+
+bool Groupe::isApproaching(const uint64_t& now_ms) const {
+    for (uint8_t i = 0; i < nb_capteurs_; i++) {
+        if (capteurs_[i]->isApproaching(now_ms)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Groupe::updateDelay(const int& delayMin, const int& delaySec) {
+    Capteur::updateDelay(delayMin, delaySec);
+    for (uint8_t i = 0; i < nb_capteurs_; i++) {
+        capteurs_[i]->updateDelay(delayMin, delaySec);
+    }
+}
+
+void Groupe::rearm(const uint64_t& now_ms) {
+    Capteur::rearm(now_ms);
+    for (uint8_t i = 0; i < nb_capteurs_; i++) {
+        capteurs_[i]->rearm(now_ms);
+    }
+}
+
+void Groupe::updateHold(const uint16_t& hold_ms, const uint16_t& release_ms, const uint16_t& debounce_ms) {
+    Capteur::updateHold(hold_ms, release_ms, debounce_ms);
+    for (uint8_t i = 0; i < nb_capteurs_; i++) {
+        capteurs_[i]->updateHold(hold_ms, release_ms, debounce_ms);
+    }
+}
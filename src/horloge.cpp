@@ -0,0 +1,8 @@
+#include "horloge.hpp"
+
+uint64_t Horloge::tick(const uint32_t& millis_now) {
+    // Unsigned difference, right across a millis() wrap
+    now_ms += (uint32_t)(millis_now - last_millis);
+    last_millis = millis_now;
+    return now_ms;
+}
@@ -1,56 +1,42 @@
 #include "infrarouge.hpp"
 
-#define MIN_LOOP 1000
-#define MIN_LOOP_2 100
+// Release windows of the "while" scenarios, unless set by the server
+#define RELEASE_MS_CUT 3000
+#define RELEASE_MS_CLEAR 1000
 
 Infrarouge::Infrarouge(const int& delayMin, const int& delaySec, const uint8_t& pin, const int& scenario)
 :Capteur(delayMin, delaySec, pin, scenario)
 {
+    input_.begin(pin_);
 }
 
 Infrarouge::~Infrarouge()
 {
 }
 
-bool Infrarouge::isTriggered(uint32_t &minutes_since_act, uint8_t &seconds_since_act, uint32_t seconds_since_boot_act_timestamp, const uint32_t& seconds_since_boot, PLAYER_STATE &player_state) {
+bool Infrarouge::isTriggered(const uint64_t &now_ms, PLAYER_STATE &player_state) {
+    input_.update();
+
     switch (scenario_)
     {
     case 1:
-        if (((minutes_since_act >= delayMin_ && seconds_since_act >= delaySec_) && !digitalRead (pin_)) || player_state == PLAYER_STATE::PLAYING)
+        if ((isReady_(now_ms) && input_.low()) || player_state == PLAYER_STATE::PLAYING)
             return true;
         else return false;
         break;
 
     case 2:
-        if (((minutes_since_act >= delayMin_ && seconds_since_act >= delaySec_)  && !digitalRead(pin_)) || (running_ && loops_since_act_ < MIN_LOOP)) {
-            running_ = true;
-            if (!digitalRead (pin_)) loops_since_act_ = 0;
-            loops_since_act_ ++;
-            return true;
-        }
-        else {
-            running_ = false;
-            return false;
-        }
+        return whilePresent_(now_ms, input_.low(), isReady_(now_ms), RELEASE_MS_CUT);
         break;
 
     case 3:
-        if (((minutes_since_act >= delayMin_ && seconds_since_act >= delaySec_) && digitalRead (pin_)) || player_state == PLAYER_STATE::PLAYING)
+        if ((isReady_(now_ms) && input_.high()) || player_state == PLAYER_STATE::PLAYING)
             return true;
         else return false;
         break;
 
     case 4:
-        if (((minutes_since_act >= delayMin_ && seconds_since_act >= delaySec_)  && digitalRead (pin_)) || (running_ && loops_since_act_ < MIN_LOOP_2)) {
-            running_ = true;
-            if (digitalRead(pin_)) loops_since_act_ = 0;
-            loops_since_act_ ++;
-            return true;
-        }
-        else {
-            running_ = false;
-            return false;
-        }
+        return whilePresent_(now_ms, input_.high(), isReady_(now_ms), RELEASE_MS_CLEAR);
         break;
 
     default:
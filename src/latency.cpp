@@ -0,0 +1,40 @@
+#include "latency.hpp"
+
+#include "log.hpp"
+
+void LatencyTrace::begin() {
+    active_ = true;
+    reached_ = 0;
+    stamps_us_[LATENCY_TRIGGER] = micros();
+    reached_ |= 1 << LATENCY_TRIGGER;
+}
+
+void LatencyTrace::mark(const LATENCY_STAGE& stage) {
+    if (!active_) {
+        return;
+    }
+    stamps_us_[stage] = micros();
+    reached_ |= 1 << stage;
+}
+
+void LatencyTrace::end() {
+    if (!active_) {
+        return;
+    }
+    mark(LATENCY_STAGE::LATENCY_FIRST_SAMPLE);
+    active_ = false;
+    if (histogram_) {
+        histogram_->observe(total());
+    }
+    printLog(__func__, LOG_INFO, "Trigger to sound %u us: start %u, pick %u, path %u, setup %u", total(),
+             at(LATENCY_STAGE::LATENCY_START), at(LATENCY_STAGE::LATENCY_PICK),
+             at(LATENCY_STAGE::LATENCY_PATH), at(LATENCY_STAGE::LATENCY_SETUP));
+}
+
+uint32_t LatencyTrace::at(const LATENCY_STAGE& stage) const {
+    uint8_t reached = stage;
+    while (reached > 0 && !(reached_ & (1 << reached))) {
+        reached--;
+    }
+    return stamps_us_[reached] - stamps_us_[LATENCY_TRIGGER];
+}
@@ -0,0 +1,196 @@
+#include "log.hpp"
+
+#define LOG_BUFFER_MASK (LOG_BUFFER_SIZE - 1)
+#define LOG_SUFFIX "\x1b[0m\r\n"
+
+// Single producer (printLog) and single consumer (logDrain) ring, indexes
+// free-running over uint16_t so that head_ - tail_ is the fill level.
+static char buffer_[LOG_BUFFER_SIZE];
+static volatile uint16_t head_ = 0;
+static volatile uint16_t tail_ = 0;
+static uint32_t dropped_ = 0;
+static uint32_t reported_dropped_ = 0;
+static bool async_ = false;
+
+static bool push_(const char* line, const uint16_t& len) {
+    uint16_t head = head_;
+    if (LOG_BUFFER_SIZE - (uint16_t)(head - tail_) < len) {
+        dropped_++;
+        return false;
+    }
+    uint16_t start = head & LOG_BUFFER_MASK;
+    uint16_t first = len < LOG_BUFFER_SIZE - start ? len : LOG_BUFFER_SIZE - start;
+    memcpy(buffer_ + start, line, first);
+    memcpy(buffer_, line + first, len - first);
+    head_ = head + len;
+    return true;
+}
+
+static void format_(const char* function, LOG_LEVEL level, const char* message, va_list args) {
+    const char* prefix = "";
+    if (level == LOG_DEBUG) {
+        prefix = "\x1b[36m" "[DEBUG] ";
+    } else if (level == LOG_INFO) {
+        prefix = "\x1b[32m" "[INFO] ";
+    } else if (level == LOG_WARNING) {
+        prefix = "\x1b[33m" "[WARNING] ";
+    } else if (level == LOG_ERROR) {
+        prefix = "\x1b[31m" "[ERROR] ";
+    }
+    char line[LOG_LINE_SIZE];
+    // Room kept for the suffix, a long message is truncated
+    const int room = sizeof(line) - sizeof(LOG_SUFFIX);
+    int len = snprintf(line, room, "%s%s : ", prefix, function);
+    if (len < room) {
+        int written = vsnprintf(line + len, room - len, message, args);
+        if (written > 0) {
+            len += written < room - len ? written : room - len - 1;
+        }
+    } else {
+        len = room - 1;
+    }
+    memcpy(line + len, LOG_SUFFIX, sizeof(LOG_SUFFIX) - 1);
+    push_(line, len + sizeof(LOG_SUFFIX) - 1);
+}
+
+static void formatf_(const char* function, LOG_LEVEL level, const char* message, ...) {
+    va_list args;
+    va_start(args, message);
+    format_(function, level, message, args);
+    va_end(args);
+}
+
+void logWrite(const char* function, LOG_LEVEL level, const char* message, ...) {
+    va_list args;
+    va_start(args, message);
+    format_(function, level, message, args);
+    va_end(args);
+    if (!async_) {
+        logFlush();
+    }
+}
+
+#ifdef LOG_TOKENIZED
+
+static const char BASE64_[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+LogRecord::LogRecord(const uint32_t& token, LOG_LEVEL level) {
+    data_[0] = token & 0xFF;
+    data_[1] = (token >> 8) & 0xFF;
+    data_[2] = (token >> 16) & 0xFF;
+    data_[3] = token >> 24;
+    data_[4] = level;
+    len_ = 5;
+    addVarint_(millis());
+}
+
+void LogRecord::addVarint_(uint64_t value) {
+    // Worst case 10 bytes, checked whole so that a record never ends mid-value
+    uint8_t raw[10];
+    uint8_t len = 0;
+    while (value >= 0x80) {
+        raw[len++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    raw[len++] = value;
+    if (len_ + len > LOG_RECORD_SIZE) {
+        len_ = LOG_RECORD_SIZE;
+        return;
+    }
+    memcpy(data_ + len_, raw, len);
+    len_ += len;
+}
+
+void LogRecord::addInteger(const int64_t& value) {
+    addVarint_(((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+void LogRecord::addString(const char* value) {
+    size_t len = value ? strnlen(value, LOG_STRING_SIZE) : 0;
+    if (len_ + 1 + len > LOG_RECORD_SIZE) {
+        len_ = LOG_RECORD_SIZE;
+        return;
+    }
+    data_[len_++] = len;
+    memcpy(data_ + len_, value, len);
+    len_ += len;
+}
+
+void LogRecord::addFloat(const float& value) {
+    if (len_ + sizeof(value) > LOG_RECORD_SIZE) {
+        len_ = LOG_RECORD_SIZE;
+        return;
+    }
+    memcpy(data_ + len_, &value, sizeof(value));
+    len_ += sizeof(value);
+}
+
+void LogRecord::commit() {
+    char line[1 + (LOG_RECORD_SIZE + 2) / 3 * 4 + 2];
+    uint16_t len = 0;
+    line[len++] = '$';
+    for (uint8_t i = 0; i < len_; i += 3) {
+        uint32_t chunk = data_[i] << 16;
+        if (i + 1 < len_) chunk |= data_[i + 1] << 8;
+        if (i + 2 < len_) chunk |= data_[i + 2];
+        line[len++] = BASE64_[(chunk >> 18) & 0x3F];
+        line[len++] = BASE64_[(chunk >> 12) & 0x3F];
+        line[len++] = i + 1 < len_ ? BASE64_[(chunk >> 6) & 0x3F] : '=';
+        line[len++] = i + 2 < len_ ? BASE64_[chunk & 0x3F] : '=';
+    }
+    line[len++] = '\r';
+    line[len++] = '\n';
+    push_(line, len);
+    if (!async_) {
+        logFlush();
+    }
+}
+
+#endif
+
+void logDrain() {
+    uint16_t tail = tail_;
+    uint16_t pending = head_ - tail;
+    int room = Serial.availableForWrite();
+    while (pending > 0 && room > 0) {
+        uint16_t start = tail & LOG_BUFFER_MASK;
+        uint16_t len = pending;
+        if (len > LOG_BUFFER_SIZE - start) {
+            len = LOG_BUFFER_SIZE - start;
+        }
+        if (len > room) {
+            len = room;
+        }
+        Serial.write((const uint8_t*)buffer_ + start, len);
+        tail += len;
+        pending -= len;
+        room -= len;
+    }
+    tail_ = tail;
+
+    // Reported in the stream once a whole line fits again
+    if (dropped_ != reported_dropped_ && LOG_BUFFER_SIZE - (uint16_t)(head_ - tail_) >= LOG_LINE_SIZE) {
+        formatf_(__func__, LOG_WARNING, "%u lines dropped", dropped_ - reported_dropped_);
+        reported_dropped_ = dropped_;
+    }
+}
+
+void logFlush() {
+    while (head_ != tail_ || dropped_ != reported_dropped_) {
+        logDrain();
+        if (head_ != tail_) {
+            yield();
+        }
+    }
+}
+
+void logSetAsync(const bool& async) {
+    async_ = async;
+    if (!async_) {
+        logFlush();
+    }
+}
+
+uint32_t logDropped() {
+    return dropped_;
+}
@@ -6,21 +6,68 @@
 #include <NTPClient.h>
 #include <WiFiManager.h>  // https://github.com/tzapu/WiFiManager
 #include <WiFiUdp.h>
+#include <i2s.h>
 
-#include "AudioFileSourceSD.h"
 #include "AudioGeneratorMP3.h"
 #include "AudioOutputI2S.h"
+#include "AudioOutputMixer.h"
+#include "boot.hpp"
 #include "bouton.hpp"
 #include "capteur.hpp"
+#include "catalogue.hpp"
+#include "dispatcher.hpp"
+#include "download.hpp"
+#include "horloge.hpp"
 #include "infrarouge.hpp"
+#include "latency.hpp"
+#include "log.hpp"
+#include "groupe.hpp"
+#include "metrics.hpp"
 #include "pir.hpp"
+#include "scheduler.hpp"
+#include "stall.hpp"
+#include "timer.hpp"
+#include "trace.hpp"
 #include "ultrason.hpp"
+#include "warm.hpp"
 
 #define VERSION_CODE "2.1.2.2"
 
 #define DELAY_FETCH 2
+// Bytes and milliseconds a sync slice may spend per loop(), while a track
+// plays (keeps the I2S buffer fed) and while idle.
+#define SYNC_SLICE_BYTES_PLAYING 1024
+#define SYNC_SLICE_MS_PLAYING 4
+#define SYNC_SLICE_BYTES_IDLE 16384
+#define SYNC_SLICE_MS_IDLE 50
 #define TIME_HOURS_RESTART 8
 #define TIME_MINS_RESTART 0
+// Until it answers, NTP is asked for the time this often
+#define RESTART_RETRY_MS 60000
+
+// Periods of the background tasks, and how long the sensor is left alone
+// once a track ends
+#define WIFI_POLL_MS 100
+#define HTTP_POLL_MS 10
+#define LOG_PERIOD_MS 60000
+#define TRACK_END_PAUSE_MS 1000
+
+// Warmed-up track kept this long after the approach stops being predicted
+#define WARM_HOLD_MS 2000
+
+#define WAITING_PATH "/waiting.mp3"
+// Waiting track faded out under the start of a triggered track
+#define WAITING_FADE_MS 500
+// What AudioGeneratorMP3::begin() allocates, with some margin: the fade
+// needs both decoders at once
+#define MP3_DECODER_HEAP 32000
+// Fade cut short once less than a quarter of the 512 sample I2S DMA ring
+// is queued, the two decoders are not keeping up
+#define FADE_CUT_FREE_SAMPLES 384
+#define MIXER_BUFFER_SAMPLES 32
+
+#define WIFI_BACKGROUND_TIMEOUT_MS 30000
+#define WIFI_PORTAL_TIMEOUT_SEC 180
 
 #define CS_PIN D1
 #define SPI_SPEED SD_SCK_MHZ(4)
@@ -32,15 +79,59 @@ constexpr uint8_t scenario = PIR_SCENARIO::PLAY_ONCE_WHEN_MOVE;
 /************************* CAN WE GO OFFLINE? *******************************/
 constexpr bool is_offline = false;
 
+/**************************** SENSE-FIRST BOOT *******************************/
+// Arm the sensor on the SD playlist right away, WiFi and the first sync
+// follow in the background. false: block on WiFi and a full sync first.
+constexpr bool sense_first_boot = true;
+
 /******************* WAITING TRACK CONFIG (optional) *************************/
 constexpr bool waiting_track = false;
 constexpr uint16_t delay_before_trigger_waiting_seconds = 0;
 
+/******************* SENSOR TRACE RECORDING (optional) ***********************/
+// Records sensor pin levels, echo durations and track starts to TRACE_PATH,
+// to be replayed on the host with [env:native_replay].
+constexpr bool record_trace = false;
+
 /************************* ONLY FOR ULTRASON *******************************/
 constexpr uint32_t time_within_minimum_sec = 5;
 constexpr uint32_t time_within_minimum_sec_2 = 10;
 constexpr uint32_t min_distance_cm = 10;
 
+/********************* ONLY FOR GROUPE (sensor group) ************************/
+// Triggers when groupe_votes of the members were triggered within
+// groupe_window_ms of each other. An ULTRASON member uses D3 as trig pin and
+// the settings above, and is only polled when its vote still matters.
+struct GroupeMember
+{
+    uint8_t type;
+    uint8_t pin;
+    uint8_t scenario;
+};
+constexpr GroupeMember groupe_members[] = {
+    {CAPTEUR_TYPE::PIR, D0, PIR_SCENARIO::PLAY_ONCE_WHEN_MOVE},
+    {CAPTEUR_TYPE::PIR, D3, PIR_SCENARIO::PLAY_ONCE_WHEN_MOVE},
+};
+constexpr uint8_t groupe_votes = 2;
+constexpr uint16_t groupe_window_ms = 2000;
+
+/********************* EXHIBIT POINTS (optional) *****************************/
+// One entry per sensor served by this module, MAX_POSTES at most. Each poste
+// plays the stored tracks whose title starts with its prefix ("" = all of
+// them). Only one track plays at a time: the highest priority trigger gets
+// the decoder, and a playing poste only yields to a strictly higher one.
+struct PosteConfig
+{
+    uint8_t type;
+    uint8_t pin;
+    uint8_t scenario;
+    const char *prefix;
+    uint8_t priority;
+};
+constexpr PosteConfig postes_config[] = {
+    {capteurType, D0, scenario, "", 0},
+};
+
 /**
  * @version 1.3.4
  * @date 01-09-2022
@@ -136,20 +227,28 @@ String idModule = "7f68d438acbc1beb2ccb494a9ffa2a6a";
 // String idModule = "f382d879def3db97acfdefeb9bc87163";
 
 AudioGeneratorMP3 *decoder = NULL;
-AudioFileSourceSD *source = NULL;
+WarmSource *track_source = NULL;
 AudioOutputI2S *output = NULL;
-
-uint32_t seconds_since_boot = 0;
-uint32_t current_min_in_seconds = 0;
-uint32_t seconds_since_boot_act_timestamp = 0;
-uint8_t seconds = 0;
-uint8_t seconds_last = 0;
-uint8_t minutes = 0;
-uint8_t hours = 0;
-uint8_t seconds_since_act = 65;
-uint32_t minutes_since_act = 10;
-bool fetch = true;
-bool gogogofetch = false;
+// With waiting_track, both decoders play through a mixer so that a trigger
+// starts the track while the waiting track fades out, see fadeOutWaitingTrack()
+AudioGeneratorMP3 *waiting_decoder = NULL;
+WarmSource *waiting_source = NULL;
+AudioOutputMixer *mixer = NULL;
+AudioOutputMixerStub *track_output = NULL;
+AudioOutputMixerStub *waiting_output = NULL;
+bool fading = false;
+uint32_t fade_start_ms = 0;
+
+Horloge horloge;
+TimerWheel timers;
+// Last approach seen while a decoder is warm, see track_source->warmTrack()
+uint32_t warm_track_ms = 0;
+// Track prepareNextTrack() could not open, not tried again before a sync
+int16_t unpreparable_track = -1;
+bool wifi_ready = false;
+uint32_t wifi_connect_start_ms = 0;
+bool wifi_portal_opened = false;
+uint32_t armed_after_ms = 0;
 bool infraredActivation = true;
 unsigned char delaySecSet = 0;
 unsigned char delayBefSecSet = 0;
@@ -170,99 +269,225 @@ typedef struct sound {
     //  int index_peer = 0;
 } t_sound;
 
+// Only SYNC_FETCH_BODY and SYNC_DOWNLOAD_BODY run while a track plays, in
+// slices. The other states wait for the decoder to be idle: TLS handshakes
+// (SYNC_FETCH, SYNC_DOWNLOAD_BEGIN) cannot be sliced, and SYNC_PRUNE,
+// SYNC_NEXT_TRACK and SYNC_COMMIT open or delete tracks on the card. With
+// tracks triggered back to back the sync waits in one of them, and each
+// handshake leaves the sensor unpolled for as long as it takes.
+enum SYNC_STATE: uint8_t {
+    SYNC_IDLE = 0,
+    SYNC_FETCH = 1,
+    SYNC_FETCH_BODY = 2,
+    SYNC_PRUNE = 3,
+    SYNC_NEXT_TRACK = 4,
+    SYNC_DOWNLOAD_BEGIN = 5,
+    SYNC_DOWNLOAD_BODY = 6,
+    SYNC_COMMIT = 7
+};
+
+enum DOWNLOAD_STATUS: uint8_t {
+    DOWNLOAD_IN_PROGRESS = 0,
+    DOWNLOAD_DONE = 1,
+    DOWNLOAD_FAILED = 2
+};
+
+// State of the catalogue sync, advanced a slice at a time by syncStep() so
+// that loop() keeps polling the sensor and feeding the decoder meanwhile.
+struct SyncJob {
+    SYNC_STATE state = SYNC_STATE::SYNC_IDLE;
+    uint8_t online = 0;  // next entry of allSoundsOnline to process
+    uint8_t index = 0;   // entries filled in newAllSoundStored
+    t_sound newAllSoundStored[NB_SON];
+
+    // Catalogue being read
+    CatalogueParser parser;
+    uint8_t fetched = 0;  // entries filled in allSoundsOnline
+
+    // Catalogue or download in progress
+    std::unique_ptr<BearSSL::WiFiClientSecure> client;
+    HTTPClient https;
+    File file;
+    SectorWriter writer;
+    DownloadMetrics metrics;
+    int len = 0;
+    uint32_t start_ms = 0;
+    uint32_t last_data_ms = 0;
+    uint32_t last_progress_ms = 0;
+    uint32_t stall_start_ms = 0;
+    uint8_t consecutive_timeouts = 0;
+    bool stalled = false;
+    bool blink = false;
+};
+
 // Function Decalration
 void MDCallback(void *cbData, const char *type, bool isUnicode,
                 const char *string);
 int     checkSoundIntegrity(t_sound toCheck, String path);
-void    checkRestart();
+void    assignPlaylists();
 void    checkUpdateSounds();
+bool    connectWifi(const uint16_t &portal_timeout_sec);
+void    commitAudios();
+Capteur *createCapteur(const uint8_t &type, const uint8_t &pin, const uint8_t &scenario);
 void    deleteTooMuch();
-int     downloadAudio(t_sound soundToUpdade);
+void    endActivation(Poste &poste);
+int     downloadBegin(const t_sound &soundToUpdade);
+DOWNLOAD_STATUS downloadStep(const size_t &budget_bytes, const uint32_t &budget_ms);
+void    downloadEnd();
 void    fetchAudiosLocal();
-void    fetchAudiosOnline();
-void    handleWaitingTrack(PLAYER_STATE &player_state, uint8_t &seconds_since_act,
-                 uint32_t &minutes_since_act);
-void    handleTrack(PLAYER_STATE &player_state, uint8_t &seconds_since_act,
-                 uint32_t &minutes_since_act);
+bool    fetchBegin();
+DOWNLOAD_STATUS fetchStep(const size_t &budget_bytes, const uint32_t &budget_ms);
+bool    fetchEnd();
+bool    audioRunning();
+void    cancelWarmTrack();
+void    fadeOutWaitingTrack();
+void    handleBackgroundWifi();
+void    handleFade();
+void    handleWaitingTrack(PLAYER_STATE &player_state);
+void    handleTrack(PLAYER_STATE &player_state, Poste &poste);
+void    handleWarmUp();
+void    onFetchTimer(void *ctx);
+void    onRestartTimer(void *ctx);
+void    onStartTimer(void *ctx);
+void    onWaitingTimer(void *ctx);
+void    onWifiReady();
+void    prepareNextTrack();
+void    releaseTrackSource();
 int     removeAudio(String filename);
-void    setUpTrack(const char *path);
-void    updateAudios();
+void    requestSync();
+void    setUpTrack(AudioFileSource *from, const char *path);
+void    setUpWaitingTrack();
+void    startTrack(const uint8_t &index);
+bool    syncStep(const bool &decoder_running);
+void    capteurTask(void *ctx);
+void    httpTask(void *ctx);
+void    handleBoot();
+void    handleMetrics();
+void    logTask(void *ctx);
+const char *phaseName(const uint8_t &phase);
+void    ntpTask(void *ctx);
+void    pumpTask(void *ctx);
+void    serialTask(void *ctx);
+void    syncTask(void *ctx);
+void    wifiTask(void *ctx);
+
+DownloadMetrics lastDownloadMetrics;
+SyncJob syncJob;
 
 t_sound allSoundsOnline[NB_SON];
 t_sound allSoundsStored[NB_SON];
 uint8_t max_sound = 0;
 
-Capteur *capteur;
-
-void printLog(const char* function, LOG_LEVEL level, const char* message, ...) {
-    if (level == LOG_INFO) {
-        Serial.print("\x1b[32m" "[INFO] ");
-    } else if (level == LOG_WARNING) {
-        Serial.print("\x1b[33m" "[WARNING] ");
-    } else if (level == LOG_ERROR) {
-        Serial.print("\x1b[31m" "[ERROR] ");
-    }
-    Serial.print(function);
-    Serial.print(" : ");
-
-    va_list args;
-    va_start(args, message);
-    char buffer[256];
-    vsnprintf(buffer, 256, message, args);
-    va_end(args);
-    Serial.print(buffer);
-    Serial.println("\x1b[0m");
-}
+Dispatcher dispatcher;
+
+// Deadlines of loop(), run by timers.advance()
+Timer fetch_timer(onFetchTimer, nullptr, DELAY_FETCH * 60000UL);
+Timer restart_timer(onRestartTimer);
+Timer start_timer(onStartTimer);
+Timer waiting_timer(onWaitingTimer);
+bool waiting_due = true;
+// Poste whose track starts once delayBefSecSet has elapsed, -1 if none
+int8_t pending_start = -1;
+bool start_due = false;
+// Poste whose track pumpTask() feeds, as last decided by capteurTask()
+int8_t feed_poste = -1;
+
+// Work of loop(), by priority: the decoder first, the rest fills the gaps
+Scheduler scheduler(timers);
+Task pump_task("pump", pumpTask, SCHEDULER_CRITICAL);
+Task capteur_task("capteur", capteurTask, 1);
+Task sync_task("sync", syncTask, 2);
+Task wifi_task("wifi", wifiTask, 3, WIFI_POLL_MS);
+Task http_task("http", httpTask, 4, HTTP_POLL_MS);
+Task ntp_task("ntp", ntpTask, 5, RESTART_RETRY_MS);
+Task log_task("log", logTask, 6, LOG_PERIOD_MS);
+Task serial_task("serial", serialTask, 7);
+// loop() iterations over STALL_BUDGET_MS, with the task responsible
+StallDetector stalls;
+// Served on /boot, with the previous boot's
+BootTimes boot_times;
+
+// Scraped on /metrics, see handleMetrics(). Only the gauges cost anything
+// at scrape time, the rest is updated where it happens.
+constexpr uint32_t PHASE_BOUNDS_US[] = {50, 100, 200, 500, 1000, 2000, 5000, 10000, 20000, 50000, 100000};
+constexpr uint32_t POLL_BOUNDS_US[] = {10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000, 30000};
+constexpr uint32_t LATENCY_BOUNDS_US[] = {1000, 2000, 5000, 10000, 20000, 50000, 100000, 200000, 500000, 1000000};
+constexpr uint32_t REFILL_BOUNDS_US[] = {500, 1000, 2000, 3000, 5000, 10000, 20000, 50000};
+#define NB_BOUNDS(bounds) (sizeof(bounds) / sizeof(bounds[0]))
+Metrics metrics;
+Histogram pump_duration("loop_phase_duration_microseconds", "Time of one run of a loop() phase",
+                        PHASE_BOUNDS_US, NB_BOUNDS(PHASE_BOUNDS_US), "phase=\"pump\"");
+Histogram capteur_duration("loop_phase_duration_microseconds", "Time of one run of a loop() phase",
+                           PHASE_BOUNDS_US, NB_BOUNDS(PHASE_BOUNDS_US), "phase=\"capteur\"");
+Histogram sync_duration("loop_phase_duration_microseconds", "Time of one run of a loop() phase",
+                        PHASE_BOUNDS_US, NB_BOUNDS(PHASE_BOUNDS_US), "phase=\"sync\"");
+Histogram poll_duration("capteur_poll_duration_microseconds", "Time of the isTriggered() poll of the postes",
+                        POLL_BOUNDS_US, NB_BOUNDS(POLL_BOUNDS_US));
+Histogram trigger_latency("trigger_to_sound_microseconds", "Time from a trigger to the first decoded samples",
+                          LATENCY_BOUNDS_US, NB_BOUNDS(LATENCY_BOUNDS_US));
+Histogram sd_refill_duration("sd_refill_duration_microseconds", "Time of one read-ahead refill from the SD card",
+                             REFILL_BOUNDS_US, NB_BOUNDS(REFILL_BOUNDS_US));
+Counter sd_reads_hit("sd_source_reads_total", "Decoder reads of a track", "result=\"hit\"");
+Counter sd_reads_miss("sd_source_reads_total", "Decoder reads of a track", "result=\"miss\"");
+Counter decoder_restarts("decoder_restarts_total", "Decoder (re)started on a track");
+Counter download_bytes("download_bytes_total", "Bytes of tracks downloaded");
+Gauge heap_free("heap_free_bytes", "Free heap");
+Gauge heap_max_block("heap_max_block_bytes", "Largest free heap block");
+Gauge heap_fragmentation("heap_fragmentation_percent", "Heap fragmentation");
+Gauge uptime("uptime_seconds", "Time since boot");
+// Current trip from a trigger to the first samples of its track
+LatencyTrace latency(&trigger_latency);
 
 void setup() {
+    boot_times.begin();
+    boot_times.start(BOOT_PHASE::BOOT_SETUP);
+    boot_times.start(BOOT_PHASE::BOOT_SERIAL);
+    stalls.begin(phaseName);
     pinMode(D2, OUTPUT);
     pinMode(D0, INPUT);
     pinMode(D3, OUTPUT);
     Serial.begin(115200);  // Initialising if(DEBUG)Serial Monitor
     delay(10);
     pinMode(LED_BUILTIN, OUTPUT);
+    boot_times.end(BOOT_PHASE::BOOT_SERIAL);
     printLog(__func__, LOG_INFO, "Starting " VERSION_CODE);
+    boot_times.report();
 
     //---------------------------------------- Read eeprom for ssid and pass
     WiFi.mode(WIFI_STA);  // explicitly set mode, esp defaults to STA+AP
     // it is a good practice to make sure your code sets wifi mode how you want
     // it.
 
-    // put your setup code here, to run once:
-    Serial.begin(115200);
-
-    // WiFiManager, Local intialization. Once its business is done, there is no
-    // need to keep it around
-    WiFiManager wm;
-
-    // Automatically connect using saved credentials,
-    // if connection fails, it starts an access point with the specified name (
-    // "AutoConnectAP"), if empty will auto generate SSID, if password is blank
-    // it will be anonymous AP (wm.autoConnect()) then goes into a blocking loop
-    // awaiting configuration and will return success result
-
-    bool res;
-
-    res = wm.autoConnect("AutoConnectAP", "");  // password protected ap
-
-    if (!res) {
-        printLog(__func__, LOG_ERROR, "Failed to connect");
-        // ESP.restart();
+    // Ends in onWifiReady()
+    boot_times.start(BOOT_PHASE::BOOT_WIFI);
+    if (sense_first_boot) {
+        // Reconnect with the credentials saved by WiFiManager without waiting,
+        // loop() picks the connection up in handleBackgroundWifi().
+        WiFi.begin();
+        wifi_connect_start_ms = millis();
     } else {
-        // if you get here you have connected to the WiFi
-        printLog(__func__, LOG_INFO, "Connected");
+        connectWifi(0);
     }
 
     audioLogger = &Serial;
 
-    source = new AudioFileSourceSD();
+    track_source = new WarmSource(&sd_refill_duration);
     output = new AudioOutputI2S();
     decoder = new AudioGeneratorMP3();
+    if (waiting_track) {
+        mixer = new AudioOutputMixer(MIXER_BUFFER_SAMPLES, output);
+        track_output = mixer->NewInput();
+        waiting_output = mixer->NewInput();
+        waiting_decoder = new AudioGeneratorMP3();
+        waiting_source = new WarmSource(&sd_refill_duration);
+    }
 
+    boot_times.start(BOOT_PHASE::BOOT_SD);
     if (!SD.begin(CS_PIN, SPI_SPEED)) {
         printLog(__func__, LOG_ERROR, "Probleme carte SD");
         return;
     }
+    boot_times.end(BOOT_PHASE::BOOT_SD);
     printLog(__func__, LOG_INFO, "SD initialisee.");
 
     for (unsigned char i = 0; i < NB_SON; ++i) {
@@ -271,261 +496,840 @@ void setup() {
         allSoundsStored[i].title.reserve(25);
     }
 
-    if (capteurType == CAPTEUR_TYPE::PIR) {
+    boot_times.start(BOOT_PHASE::BOOT_CAPTEURS);
+    for (const PosteConfig &config : postes_config) {
+        Capteur *capteur = createCapteur(config.type, config.pin, config.scenario);
+        if (capteur == nullptr) {
+            printLog(__func__, LOG_ERROR, "Capteur non reconnu");
+            ESP.restart();
+        }
+        dispatcher.add(capteur, config.prefix, config.priority);
+    }
+    boot_times.end(BOOT_PHASE::BOOT_CAPTEURS);
+
+    if (record_trace) {
+        TraceHeader header;
+        header.capteur_type = capteurType;
+        header.scenario = scenario;
+        header.delay_min = delayMinSet;
+        header.delay_sec = delaySecSet;
+        header.min_distance = min_distance_cm;
+        header.time_within_minimum_sec = time_within_minimum_sec;
+        header.time_within_minimum_sec_2 = time_within_minimum_sec_2;
+        traceRecorder.begin(TRACE_PATH, header);
+    }
+
+    boot_times.start(BOOT_PHASE::BOOT_FETCH_LOCAL);
+    fetchAudiosLocal();
+    boot_times.end(BOOT_PHASE::BOOT_FETCH_LOCAL);
+    timers.advance(horloge.tick(millis()));
+    timers.schedule(fetch_timer, fetch_timer.period_ms);
+    for (Task *task : {&pump_task, &capteur_task, &sync_task, &wifi_task, &http_task, &ntp_task, &log_task,
+                       &serial_task}) {
+        scheduler.add(*task);
+    }
+    pump_task.duration = &pump_duration;
+    capteur_task.duration = &capteur_duration;
+    sync_task.duration = &sync_duration;
+    for (Metric *metric : std::initializer_list<Metric *>{
+             &pump_duration, &capteur_duration, &sync_duration, &poll_duration, &trigger_latency,
+             &sd_refill_duration, &sd_reads_hit, &sd_reads_miss, &decoder_restarts, &download_bytes, &heap_free, &heap_max_block, &heap_fragmentation, &uptime}) {
+        metrics.add(*metric);
+    }
+    // Both need the network, see onWifiReady()
+    scheduler.suspend(http_task);
+    scheduler.suspend(ntp_task);
+    scheduler.sleep(log_task, LOG_PERIOD_MS);
+    scheduler.watch(stalls);
+    stalls.report();
+    armed_after_ms = millis();
+    printLog(__func__, LOG_INFO, "Sensor armed after %d ms", armed_after_ms);
+
+    if (!sense_first_boot) {
+        onWifiReady();
+    }
+    boot_times.end(BOOT_PHASE::BOOT_SETUP);
+    // From now on Serial is written by serialTask()
+    logSetAsync(true);
+}
+
+Capteur *createCapteur(const uint8_t &type, const uint8_t &pin, const uint8_t &scenario) {
+    if (type == CAPTEUR_TYPE::GROUPE) {
+        Groupe *groupe = new Groupe(delayMinSet, delaySecSet, groupe_votes, groupe_window_ms);
+        for (const GroupeMember &member : groupe_members) {
+            Capteur *membre = member.type == CAPTEUR_TYPE::GROUPE
+                                  ? nullptr
+                                  : createCapteur(member.type, member.pin, member.scenario);
+            if (membre == nullptr) {
+                delete groupe;
+                return nullptr;
+            }
+            groupe->add(membre, member.type == CAPTEUR_TYPE::ULTRASON);
+        }
+        return groupe;
+    }
+    if (type != CAPTEUR_TYPE::ULTRASON) {
+        pinMode(pin, INPUT);
+    }
+    if (type == CAPTEUR_TYPE::PIR) {
         // capteur = new PIR(0, 10, D0, scenario);
-        capteur = new Pir(delayMinSet, delaySecSet, D0, scenario);
-    } else if (capteurType == CAPTEUR_TYPE::BOUTON) {
+        return new Pir(delayMinSet, delaySecSet, pin, scenario);
+    } else if (type == CAPTEUR_TYPE::BOUTON) {
 
         // capteur = new Bouton(0, 10, D3, scenario);
-        capteur = new Bouton(delayMinSet, delaySecSet, D0, scenario);
-    } else if (capteurType == CAPTEUR_TYPE::INFRAROUGE) {
+        return new Bouton(delayMinSet, delaySecSet, pin, scenario);
+    } else if (type == CAPTEUR_TYPE::INFRAROUGE) {
         // capteur = new Infrarouge(0, 10, D0, scenario);
-        capteur = new Infrarouge(delayMinSet, delaySecSet, D0, scenario);
+        return new Infrarouge(delayMinSet, delaySecSet, pin, scenario);
     }
-    else if (capteurType == CAPTEUR_TYPE::ULTRASON) {
-      capteur = new Ultrason(delayMinSet, delaySecSet, D0, scenario, D3, min_distance_cm, time_within_minimum_sec, time_within_minimum_sec_2);
+    else if (type == CAPTEUR_TYPE::ULTRASON) {
+      // Echo on D0 (GPIO16, no interrupt) is timed by a pulseIn() bounded by
+      // the sensor range, an interrupt-capable pin makes it non-blocking
+      return new Ultrason(delayMinSet, delaySecSet, pin, scenario, D3, min_distance_cm, time_within_minimum_sec, time_within_minimum_sec_2);
     }
-    else {
-        printLog(__func__, LOG_ERROR, "Capteur non reconnu");
-        ESP.restart();
+    return nullptr;
+}
+
+bool connectWifi(const uint16_t &portal_timeout_sec) {
+    // WiFiManager, Local intialization. Once its business is done, there is no
+    // need to keep it around
+    WiFiManager wm;
+
+    // Automatically connect using saved credentials,
+    // if connection fails, it starts an access point with the specified name (
+    // "AutoConnectAP"), if empty will auto generate SSID, if password is blank
+    // it will be anonymous AP (wm.autoConnect()) then goes into a blocking loop
+    // awaiting configuration and will return success result
+    if (portal_timeout_sec > 0) {
+        wm.setConfigPortalTimeout(portal_timeout_sec);
     }
 
-    fetchAudiosLocal();
+    bool res;
+
+    res = wm.autoConnect("AutoConnectAP", "");  // password protected ap
+
+    if (!res) {
+        printLog(__func__, LOG_ERROR, "Failed to connect");
+        // ESP.restart();
+    } else {
+        // if you get here you have connected to the WiFi
+        printLog(__func__, LOG_INFO, "Connected");
+    }
+    return res;
+}
+
+void handleBackgroundWifi() {
+    if (WiFi.status() == WL_CONNECTED) {
+        printLog(__func__, LOG_INFO, "Connected after %d ms", millis());
+        onWifiReady();
+    } else if (millis() - wifi_connect_start_ms >= WIFI_BACKGROUND_TIMEOUT_MS) {
+        // The portal blocks the sensor and the decoder: only for a module
+        // with nothing saved, once per boot and for a bounded time. A saved
+        // network out of reach is retried in the background.
+        if (WiFi.SSID().length() == 0 && !wifi_portal_opened) {
+            wifi_portal_opened = true;
+            printLog(__func__, LOG_WARNING, "No WiFi saved, opening portal");
+            if (connectWifi(WIFI_PORTAL_TIMEOUT_SEC)) {
+                onWifiReady();
+                return;
+            }
+        } else {
+            printLog(__func__, LOG_WARNING, "No WiFi after %d ms, retrying", WIFI_BACKGROUND_TIMEOUT_MS);
+        }
+        WiFi.begin();
+        wifi_connect_start_ms = millis();
+    }
+}
+
+void onWifiReady() {
+    wifi_ready = true;
+    boot_times.end(BOOT_PHASE::BOOT_WIFI);
+    // Ends once the first sync is committed, see syncStep()
+    boot_times.start(BOOT_PHASE::BOOT_SYNC);
     if (!is_offline) {
-        checkUpdateSounds();
+        if (sense_first_boot) {
+            requestSync();
+        } else {
+            checkUpdateSounds();
+        }
     }
 
+    boot_times.start(BOOT_PHASE::BOOT_NTP);
     timeClient.begin();
     timeClient.setTimeOffset(7200);
+    server.on("/boot", handleBoot);
+    server.on("/metrics", handleMetrics);
+    server.begin();
+    scheduler.suspend(wifi_task);
+    scheduler.wake(ntp_task);
+    scheduler.wake(http_task);
 }
 
 void loop() {
-    seconds_since_boot = millis() /
-              1000;  // the number of milliseconds that have passed since boot
-    seconds = seconds_since_boot - current_min_in_seconds;
-    if (seconds_last != seconds) {
-        seconds_since_act++;
-    }
-    seconds_last = seconds;
-
-    // Every minute, we add a minute to the clock.
-    if (seconds >= 60) {
-        printLog(__func__, LOG_INFO, "ESP.getFreeHeap(): %d", ESP.getFreeHeap());
-        printLog(__func__, LOG_INFO, "Nb fetch: %d", nbFetch);
-        current_min_in_seconds = seconds_since_boot;
-        minutes = minutes + 1;
-        fetch = true; // Every min we ask to fetch
-        checkRestart();
-    }
-
-    // the number of seconds that have passed since the last time 60 seconds was
-    // reached.
-    if (seconds_since_act == 60) {
-        seconds_since_act = 0;
-        minutes_since_act++;
-    }
-
-    if ((minutes % DELAY_FETCH == 0 && fetch) || (gogogofetch)) {
-        if (!decoder->isRunning()) {
-            if (!is_offline) {
-                checkUpdateSounds();
-            }
-            fetch = false;
-            gogogofetch = false;
-        } else {
-            gogogofetch = true;
-        }
-    }
+    stalls.beginIteration();
+    stalls.enter(STALL_PHASE_TIMERS);
+    timers.advance(horloge.tick(millis()));
+    stalls.exit();
+    scheduler.run();
+    stalls.endIteration();
+}
+
+const char *phaseName(const uint8_t &phase) {
+    return phase < scheduler.size() ? scheduler.task(phase).name : nullptr;
+}
 
-    // if one minute has passed, start counting milliseconds from zero again and
-    // add one minute to the clock.
-    if (minutes >= 60) {
-        minutes = 0;
-        hours = hours + 1;
+// Feeds the decoder with the track of the triggered poste, or the waiting
+// track. Serviced between every other task.
+void pumpTask(void *ctx) {
+    if (feed_poste >= 0) {
+        handleTrack(player_state, dispatcher.poste(feed_poste));
+    } else if (player_state == PLAYER_STATE::WAITING) {
+        handleWaitingTrack(player_state);
     }
+    if (waiting_track) {
+        handleFade();
+        mixer->loop();
+    }
+}
 
+// Polls the postes, starts and stops tracks, pumpTask() does the decoding.
+void capteurTask(void *ctx) {
     if (player_state == PLAYER_STATE::PLAYING) {
         digitalWrite(D2, HIGH);
     } else {
         digitalWrite(D2, LOW);
     }
 
-    if (capteur->isTriggered(minutes_since_act, seconds_since_act, seconds_since_boot_act_timestamp,
-                             seconds_since_boot, player_state)) {
+    PLAYER_STATE previous_state = player_state;
+    uint32_t poll_start_us = micros();
+    int8_t triggered = dispatcher.poll(horloge.now_ms, player_state);
+    poll_duration.observe(micros() - poll_start_us);
+    if (triggered < 0 && previous_state == PLAYER_STATE::PLAYING && player_state != PLAYER_STATE::PLAYING) {
+        // Stopped by the capteur itself (button released)
+        endActivation(dispatcher.owner());
+    }
+    if (triggered >= 0 && pending_start < 0 &&
+        player_state != PLAYER_STATE::PLAYING && player_state != PLAYER_STATE::PAUSED) {
         infraredActivation = false;
-        if (player_state != PLAYER_STATE::PLAYING && player_state != PLAYER_STATE::PAUSED) {
-            printLog(__func__, LOG_INFO, "Started song after delay");
-            delay(delayBefSecSet * 1000);
-            capteur->pickMusic();
-            String pathString = allSoundsStored[capteur->getCurrentIndex()].path;
-            char path[64];
-            pathString.toCharArray(path, 64);
-            printLog(__func__, LOG_INFO, "Titre: %s",
-                        allSoundsStored[capteur->getCurrentIndex()].title.c_str());
-            setUpTrack(path);
-        }
-        handleTrack(player_state, seconds_since_act, minutes_since_act);
-        delay(10);
-    } else if (waiting_track && ((minutes_since_act * 60 + seconds_since_act >= delay_before_trigger_waiting_seconds) || player_state == PLAYER_STATE::WAITING)) {
+        traceRecorder.trigger();
+        pending_start = triggered;
+        if (delayBefSecSet > 0) {
+            printLog(__func__, LOG_INFO, "Starting song in %d s", delayBefSecSet);
+            timers.schedule(start_timer, delayBefSecSet * 1000UL);
+        } else {
+            start_due = true;
+            latency.begin();
+        }
+    }
+    if (start_due) {
+        // Starts even if the capteur stopped triggering during the delay
+        start_due = false;
+        triggered = pending_start;
+        pending_start = -1;
+        startTrack(triggered);
+    }
+
+    // Nothing to feed while start_timer is pending
+    feed_poste = pending_start >= 0 ? -1 : triggered;
+    if (pending_start >= 0 || triggered >= 0) {
+        return;
+    }
+    if (waiting_track && (waiting_due || player_state == PLAYER_STATE::WAITING)) {
         if (player_state != PLAYER_STATE::WAITING) {
             printLog(__func__, LOG_INFO, "Waiting...");
-            setUpTrack("/waiting.mp3");
+            // The mixer only writes what all its begun inputs have: left
+            // unfed, a warm decoder on track_output would stall this track.
+            if (track_source->warmTrack() >= 0) {
+                cancelWarmTrack();
+            }
+            setUpWaitingTrack();
             player_state = PLAYER_STATE::WAITING;
         }
-        handleWaitingTrack(player_state, seconds_since_act, minutes_since_act);
+        prepareNextTrack();
+    } else if (player_state == PLAYER_STATE::STOPPED) {
+        handleWarmUp();
+    }
+}
+
+void syncTask(void *ctx) {
+    syncStep(audioRunning());
+}
+
+// Until the network is up, see onWifiReady()
+void wifiTask(void *ctx) {
+    handleBackgroundWifi();
+}
+
+void httpTask(void *ctx) {
+    server.handleClient();
+}
+
+// Boot phase times of this boot and the previous one, as JSON
+void handleBoot() {
+    static char json[BOOT_JSON_SIZE];
+    size_t len = boot_times.json(json, sizeof(json));
+    server.setContentLength(len);
+    server.send(200, "application/json", "");
+    server.sendContent(json, len);
+}
+
+// Prometheus text format, sent a metric per chunk from a static buffer so
+// that scraping takes nothing from the heap it reports on.
+void handleMetrics() {
+    heap_free.set(ESP.getFreeHeap());
+    heap_max_block.set(ESP.getMaxFreeBlockSize());
+    heap_fragmentation.set(ESP.getHeapFragmentation());
+    uptime.set(horloge.now_ms / 1000);
+
+    static char chunk[METRICS_CHUNK_SIZE];
+    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server.send(200, METRICS_CONTENT_TYPE, "");
+    for (uint8_t i = 0; i < metrics.size(); i++) {
+        size_t len = metrics.write(i, chunk, sizeof(chunk));
+        server.sendContent(chunk, len);
+    }
+}
+
+// Looks the time up until NTP answers, then arms restart_timer for the next
+// TIME_HOURS_RESTART:TIME_MINS_RESTART.
+void ntpTask(void *ctx) {
+    timeClient.update();
+    if (!timeClient.isTimeSet()) {
+        return;
+    }
+    boot_times.end(BOOT_PHASE::BOOT_NTP);
+    uint32_t now_sec = timeClient.getHours() * 3600UL + timeClient.getMinutes() * 60 + timeClient.getSeconds();
+    uint32_t restart_sec = TIME_HOURS_RESTART * 3600UL + TIME_MINS_RESTART * 60;
+    // Never right away, booting at restart time must not loop
+    uint32_t wait_sec = (restart_sec + 86400 - now_sec) % 86400;
+    if (wait_sec == 0) {
+        wait_sec = 86400;
+    }
+    printLog(__func__, LOG_INFO, "Time: %d:%d, restart in %d s", timeClient.getHours(),
+             timeClient.getMinutes(), wait_sec);
+    timers.schedule(restart_timer, wait_sec * 1000);
+    scheduler.suspend(ntp_task);
+}
+
+// Serial output of printLog(), written while the I2S DMA buffer is full so
+// that even a FIFO refill never competes with the decoder.
+void serialTask(void *ctx) {
+    if (!audioRunning() || i2s_is_full()) {
+        logDrain();
+    }
+}
+
+void logTask(void *ctx) {
+    printLog(__func__, LOG_INFO, "ESP.getFreeHeap(): %d", ESP.getFreeHeap());
+    printLog(__func__, LOG_INFO, "Nb fetch: %d", nbFetch);
+    printLog(__func__, LOG_INFO, "Log lines dropped: %u", logDropped());
+    scheduler.report();
+    traceRecorder.flush();
+}
+
+void startTrack(const uint8_t &index) {
+    Poste &poste = dispatcher.poste(index);
+    latency.mark(LATENCY_STAGE::LATENCY_START);
+    printLog(__func__, LOG_INFO, "Started song after delay");
+    timers.cancel(waiting_timer);
+    waiting_due = false;
+    poste.capteur->pickMusic();
+    latency.mark(LATENCY_STAGE::LATENCY_PICK);
+    uint8_t track = poste.capteur->getCurrentTrack();
+    char path[64];
+    allSoundsStored[track].path.toCharArray(path, 64);
+    latency.mark(LATENCY_STAGE::LATENCY_PATH);
+    printLog(__func__, LOG_INFO, "Poste %d, titre: %s", index,
+                allSoundsStored[track].title.c_str());
+    if (track_source->takeWarm(track)) {
+        printLog(__func__, LOG_INFO, "Track already warm");
+        if (waiting_track) {
+            fadeOutWaitingTrack();
+        }
+    } else {
+        setUpTrack(track_source, path);
+        latency.mark(LATENCY_STAGE::LATENCY_SETUP);
     }
 }
 
-void handleWaitingTrack(PLAYER_STATE &player_state, uint8_t &seconds_since_act,
-                 uint32_t &minutes_since_act) {
+// The track of poste is over, or its capteur stopped it: no new trigger of
+// this poste before its delay, the waiting track after its own.
+void endActivation(Poste &poste) {
+    poste.capteur->rearm(horloge.now_ms);
+    timers.schedule(waiting_timer, delay_before_trigger_waiting_seconds * 1000UL);
+}
+
+void onFetchTimer(void *ctx) {
+    if (!is_offline && wifi_ready) {
+        requestSync();
+    }
+}
+
+void onRestartTimer(void *ctx) {
+    printLog(__func__, LOG_INFO, "Daily restart");
+    logFlush();
+    ESP.restart();
+}
+
+void onStartTimer(void *ctx) {
+    start_due = true;
+    latency.begin();
+}
+
+void onWaitingTimer(void *ctx) {
+    waiting_due = true;
+}
+
+// Opens the next track and starts the decoder while someone approaches,
+// handleTrack() only has to feed it once the trigger comes. Decoding only
+// happens in handleTrack(), so a warm decoder stays silent.
+void handleWarmUp() {
+    // Highest priority poste expecting a trigger
+    Poste *approaching = nullptr;
+    for (uint8_t i = 0; i < dispatcher.size(); i++) {
+        Poste &poste = dispatcher.poste(i);
+        if (poste.capteur->hasTracks() && poste.capteur->isApproaching(horloge.now_ms) &&
+            (approaching == nullptr || poste.priority > approaching->priority)) {
+            approaching = &poste;
+        }
+    }
+    if (approaching != nullptr) {
+        Capteur *capteur = approaching->capteur;
+        if (track_source->warmTrack() != capteur->getNextTrack()) {
+            uint8_t index = capteur->getNextTrack();
+            char path[64];
+            allSoundsStored[index].path.toCharArray(path, 64);
+            printLog(__func__, LOG_INFO, "Warming up %s", path);
+            setUpTrack(track_source, path);
+            track_source->setWarm(index);
+        }
+        warm_track_ms = millis();
+    } else if (track_source->warmTrack() >= 0 && millis() - warm_track_ms > WARM_HOLD_MS) {
+        cancelWarmTrack();
+    } else if (track_source->warmTrack() < 0) {
+        prepareNextTrack();
+        if (waiting_track && !waiting_source->isPrepared(WAITING_PATH)) {
+            waiting_source->prepare(WAITING_PATH);
+        }
+    }
+}
+
+// Opens the next track of the highest priority poste and reads its first
+// frames ahead, for a trigger to start the decoder from RAM. Done again
+// after each play, as the decoder closes its source, and after each sync.
+void prepareNextTrack() {
+    Poste *next = nullptr;
+    for (uint8_t i = 0; i < dispatcher.size(); i++) {
+        Poste &poste = dispatcher.poste(i);
+        if (poste.capteur->hasTracks() && (next == nullptr || poste.priority > next->priority)) {
+            next = &poste;
+        }
+    }
+    if (next == nullptr || max_sound == 0) {
+        return;
+    }
+    uint8_t index = next->capteur->getNextTrack();
+    char path[64];
+    allSoundsStored[index].path.toCharArray(path, 64);
+    if (index == unpreparable_track || track_source->isPrepared(path)) {
+        return;
+    }
+    printLog(__func__, LOG_INFO, "Preparing %s", path);
+    if (!track_source->prepare(path)) {
+        unpreparable_track = index;
+    }
+}
+
+// No track file may stay open while one is deleted, prepareNextTrack()
+// opens the next one again afterwards
+void releaseTrackSource() {
+    if (track_source->warmTrack() >= 0) {
+        cancelWarmTrack();
+    } else {
+        track_source->close();
+    }
+}
+
+void cancelWarmTrack() {
+    printLog(__func__, LOG_INFO, "Approach not confirmed, cancelling warm track");
+    decoder->stop();
+    track_source->close();
+}
+
+void handleWaitingTrack(PLAYER_STATE &player_state) {
     static int lastms = 0;
-    if (decoder->isRunning()) {
+    if (waiting_decoder->isRunning()) {
         if (millis() - lastms > 1000) {
             lastms = millis();
-            printLog(__func__, LOG_INFO, "Running for %d s...", lastms);
+            printLog(__func__, LOG_DEBUG, "Running for %d s...", lastms);
         }
-        if (!decoder->loop()) decoder->stop();
+        if (!waiting_decoder->loop()) waiting_decoder->stop();
     } else {
         printLog(__func__, LOG_INFO, "MP3 done");
-        delay(1000);
+        scheduler.sleep(capteur_task, TRACK_END_PAUSE_MS);
         player_state = PLAYER_STATE::STOPPED;
     }
 }
 
-void handleTrack(PLAYER_STATE &player_state, uint8_t &seconds_since_act,
-                 uint32_t &minutes_since_act) {
+void handleTrack(PLAYER_STATE &player_state, Poste &poste) {
     static int lastms = 0;
     if (decoder->isRunning()) {
         player_state = PLAYER_STATE::PLAYING;
         if (millis() - lastms > 1000) {
             lastms = millis();
-            printLog(__func__, LOG_INFO, "Running for %d ms...", lastms);
+            printLog(__func__, LOG_DEBUG, "Running for %d ms...", lastms);
         }
         if (!decoder->loop()) decoder->stop();
+        latency.end();
     } else {
         printLog(__func__, LOG_INFO, "MP3 done");
-        delay(1000);
+        latency.cancel();
+        const ReadAheadMetrics &reads = track_source->metrics();
+        reads.log("Track reads");
+        sd_reads_hit.inc(reads.hits);
+        sd_reads_miss.inc(reads.reads - reads.hits);
+        scheduler.sleep(capteur_task, TRACK_END_PAUSE_MS);
+        feed_poste = -1;
         player_state = PLAYER_STATE::STOPPED;
-        seconds_since_act = 0;
-        minutes_since_act = 0;
+        endActivation(poste);
     }
 }
 
-void setUpTrack(const char *path) {
+void setUpTrack(AudioFileSource *from, const char *path) {
     printLog(__func__, LOG_INFO, "Setting up track");
     if (decoder->isRunning()) {
         printLog(__func__, LOG_INFO, "Stopping decoder");
         decoder->stop();
     }
-    source->close();
-    source->open(path);
-    decoder->begin(source, output);
+    // No SD access if prepareNextTrack() got there first
+    from->open(path);
+    if (waiting_track) {
+        fadeOutWaitingTrack();
+        decoder->begin(from, track_output);
+    } else {
+        decoder->begin(from, output);
+    }
+    decoder_restarts.inc();
+}
+
+// Prepared while idle between two plays, see handleWarmUp()
+void setUpWaitingTrack() {
+    if (waiting_decoder->isRunning()) {
+        waiting_decoder->stop();
+    }
+    fading = false;
+    waiting_source->open(WAITING_PATH);
+    waiting_output->SetGain(1.0);
+    waiting_decoder->begin(waiting_source, waiting_output);
+    decoder_restarts.inc();
+}
+
+// The waiting track keeps playing under the first WAITING_FADE_MS of the
+// track, both through the mixer, so that I2S never stops. Cut right away
+// when the heap has no room for a second decoder.
+void fadeOutWaitingTrack() {
+    if (!waiting_decoder->isRunning()) {
+        return;
+    }
+    if (ESP.getMaxFreeBlockSize() < MP3_DECODER_HEAP) {
+        printLog(__func__, LOG_WARNING, "No heap for the fade, waiting track cut");
+        waiting_decoder->stop();
+        return;
+    }
+    fading = true;
+    fade_start_ms = millis();
+}
+
+// Decodes the waiting track at a falling gain while it fades out. Two
+// decoders may not fit in the CPU: the fade ends early rather than let
+// the I2S DMA ring run dry.
+void handleFade() {
+    if (!fading) {
+        return;
+    }
+    uint32_t elapsed_ms = millis() - fade_start_ms;
+    bool starving = i2s_available() > FADE_CUT_FREE_SAMPLES;
+    if (elapsed_ms >= WAITING_FADE_MS || starving || !waiting_decoder->isRunning() ||
+        !waiting_decoder->loop()) {
+        if (starving) {
+            printLog(__func__, LOG_WARNING, "I2S running low, fade cut after %u ms", elapsed_ms);
+        }
+        waiting_decoder->stop();
+        fading = false;
+        return;
+    }
+    waiting_output->SetGain((float)(WAITING_FADE_MS - elapsed_ms) / WAITING_FADE_MS);
+}
+
+// A warmed-up decoder is running but not fed, see handleWarmUp(). It does
+// not count, so the sync runs under it: every sync path that closes or
+// deletes a track has to go through releaseTrackSource(), which cancels it.
+bool audioRunning() {
+    return (decoder->isRunning() && track_source->warmTrack() < 0) || (waiting_track && waiting_decoder->isRunning());
 }
 
 void checkUpdateSounds() {
-    fetchAudiosOnline();
-    nbFetch++;
-    deleteTooMuch();
-
-    updateAudios();
-    for (uint8_t i = 0; i < max_sound; ++i) {
-        Serial.println(F("----------------------------------------"));
-        printLog(__func__, LOG_INFO, "allSoundsOnline[%d].title: %s", i,
-                 allSoundsOnline[i].title.c_str());
-        Serial.println("---------");
-        printLog(__func__, LOG_INFO, "allSoundsStored[%d].id: %d", i,
-                 allSoundsStored[i].title.c_str());
+    requestSync();
+    while (syncStep(false)) {
+        yield();
     }
-    printLog(__func__, LOG_INFO, "ESP.getFreeHeap(): %d", ESP.getFreeHeap());
 }
 
-void checkRestart() {
-    timeClient.update();
-    int currentHour = timeClient.getHours();
+void requestSync() {
+    if (syncJob.state == SYNC_STATE::SYNC_IDLE) {
+        printLog(__func__, LOG_INFO, "Sync requested");
+        syncJob.state = SYNC_STATE::SYNC_FETCH;
+    }
+}
 
-    int currentMinute = timeClient.getMinutes();
+bool syncStep(const bool &decoder_running) {
+    switch (syncJob.state) {
+        case SYNC_STATE::SYNC_IDLE:
+            return false;
+
+        case SYNC_STATE::SYNC_FETCH:
+            if (decoder_running) return true;
+            nbFetch++;
+            if (!fetchBegin()) {
+                syncJob.state = SYNC_STATE::SYNC_IDLE;
+                return false;
+            }
+            syncJob.state = SYNC_STATE::SYNC_FETCH_BODY;
+            return true;
+
+        case SYNC_STATE::SYNC_FETCH_BODY: {
+            DOWNLOAD_STATUS status =
+                decoder_running
+                    ? fetchStep(SYNC_SLICE_BYTES_PLAYING, SYNC_SLICE_MS_PLAYING)
+                    : fetchStep(SYNC_SLICE_BYTES_IDLE, SYNC_SLICE_MS_IDLE);
+            if (status == DOWNLOAD_STATUS::DOWNLOAD_IN_PROGRESS) return true;
+            // Nothing is deleted on a bad or truncated catalogue
+            if (!fetchEnd()) {
+                syncJob.state = SYNC_STATE::SYNC_IDLE;
+                return false;
+            }
+            syncJob.state = SYNC_STATE::SYNC_PRUNE;
+            return true;
+        }
 
-    printLog(__func__, LOG_INFO, "Time: %d:%d", currentHour, currentMinute);
-    if ((currentHour == TIME_HOURS_RESTART) &&
-        (currentMinute == TIME_MINS_RESTART))
-        ESP.restart();
+        case SYNC_STATE::SYNC_PRUNE:
+            if (decoder_running) return true;
+            // The prepared or warm track may be deleted
+            releaseTrackSource();
+            deleteTooMuch();
+            for (unsigned char i = 0; i < NB_SON; ++i)
+                syncJob.newAllSoundStored[i] = t_sound();
+            syncJob.online = 0;
+            syncJob.index = 0;
+            syncJob.state = SYNC_STATE::SYNC_NEXT_TRACK;
+            return true;
+
+        case SYNC_STATE::SYNC_NEXT_TRACK: {
+            // checkSoundIntegrity() opens, and may delete, a stored track
+            if (decoder_running) return true;
+            if (syncJob.online >= NB_SON ||
+                allSoundsOnline[syncJob.online].title == "") {
+                syncJob.state = SYNC_STATE::SYNC_COMMIT;
+                return true;
+            }
+            t_sound &online = allSoundsOnline[syncJob.online];
+            for (unsigned char stored = 0; stored < NB_SON; ++stored) {
+                // Si dans les fichiers locaux, on a déjà le fichier online
+                // correspondant, on copie les info si nécessaire et on passe.
+                if (online.title == allSoundsStored[stored].title) {
+                    syncJob.newAllSoundStored[syncJob.index] =
+                        allSoundsStored[stored];  // On copie l'ancien dans le
+                                                  // nouveau
+                    syncJob.newAllSoundStored[syncJob.index++].id =
+                        online.id;  // On rajoute l'id
+                    checkSoundIntegrity(online, "/" + online.title);
+                    syncJob.online++;
+                    return true;
+                }
+            }
+            // Sinon il faut downloader le son en ligne pour l'avoir en local
+            printLog(__func__, LOG_INFO, "To update: %d %s", online.id,
+                     online.title.c_str());
+            syncJob.state = SYNC_STATE::SYNC_DOWNLOAD_BEGIN;
+            return true;
+        }
+
+        case SYNC_STATE::SYNC_DOWNLOAD_BEGIN:
+            if (decoder_running) return true;
+            if (downloadBegin(allSoundsOnline[syncJob.online]) == 0) {
+                syncJob.state = SYNC_STATE::SYNC_DOWNLOAD_BODY;
+            } else {
+                printLog(__func__, LOG_ERROR, "Audio could not be downloaded");
+                syncJob.online++;
+                syncJob.state = SYNC_STATE::SYNC_NEXT_TRACK;
+            }
+            return true;
+
+        case SYNC_STATE::SYNC_DOWNLOAD_BODY: {
+            DOWNLOAD_STATUS status =
+                decoder_running
+                    ? downloadStep(SYNC_SLICE_BYTES_PLAYING, SYNC_SLICE_MS_PLAYING)
+                    : downloadStep(SYNC_SLICE_BYTES_IDLE, SYNC_SLICE_MS_IDLE);
+            if (status == DOWNLOAD_STATUS::DOWNLOAD_IN_PROGRESS) return true;
+            downloadEnd();
+
+            // On vérifie le son téléchargé, puis on update les différentes infos
+            t_sound &online = allSoundsOnline[syncJob.online];
+            if (checkSoundIntegrity(online, "/" + online.title) == 0) {
+                t_sound &installed = syncJob.newAllSoundStored[syncJob.index++];
+                installed.id = online.id;
+                installed.size = online.size;
+                installed.path = "/" + online.title;
+                installed.title = online.title;
+                printLog(__func__, LOG_INFO, "Audio properly installed");
+            } else {
+                printLog(__func__, LOG_ERROR,
+                         "Audio was deleted because not complete");
+            }
+            syncJob.online++;
+            syncJob.state = SYNC_STATE::SYNC_NEXT_TRACK;
+            return true;
+        }
+
+        case SYNC_STATE::SYNC_COMMIT:
+            // The playlist is only swapped while nothing plays from it.
+            if (decoder_running) return true;
+            commitAudios();
+            // prepareNextTrack() picks from the new list
+            releaseTrackSource();
+            unpreparable_track = -1;
+            for (uint8_t i = 0; i < max_sound; ++i) {
+                printLog(__func__, LOG_INFO, "allSoundsOnline[%d].title: %s", i,
+                         allSoundsOnline[i].title.c_str());
+                printLog(__func__, LOG_INFO, "allSoundsStored[%d].id: %d", i,
+                         allSoundsStored[i].id);
+            }
+            printLog(__func__, LOG_INFO, "ESP.getFreeHeap(): %d", ESP.getFreeHeap());
+            syncJob.state = SYNC_STATE::SYNC_IDLE;
+            boot_times.end(BOOT_PHASE::BOOT_SYNC);
+            return false;
+
+        default:
+            syncJob.state = SYNC_STATE::SYNC_IDLE;
+            return false;
+    }
+}
+
+void storeOnlineTrack(const CatalogueTrack &track, void *ctx) {
+    uint8_t &index = *static_cast<uint8_t *>(ctx);
+    if (index >= NB_SON) {
+        printLog(__func__, LOG_WARNING, "More than %d sounds online, skipping %s",
+                 NB_SON, track.title);
+        return;
+    }
+    allSoundsOnline[index].title = track.title;
+    allSoundsOnline[index].size = track.size;
+    allSoundsOnline[index++].id = track.id;
 }
 
-void fetchAudiosOnline() {
+// Sends the catalogue request, allSoundsOnline is filled by fetchStep().
+// Blocks for the TLS handshake and the response headers.
+bool fetchBegin() {
     printLog(__func__, LOG_INFO, "Fetching online sounds");
     for (unsigned char i = 0; i < NB_SON; ++i) {
         allSoundsOnline[i].title = "";
         allSoundsOnline[i].size = 0;
         allSoundsOnline[i].id = 0;
     }
-    String payload;
-    std::unique_ptr<BearSSL::WiFiClientSecure> client(
-        new BearSSL::WiFiClientSecure);
-    client->setInsecure();
-    HTTPClient https;
-    printLog(__func__, LOG_INFO, "[HTTPS] begin...\n");
-    if (https.begin(
-            *client,
+    syncJob.fetched = 0;
+    syncJob.parser.begin(storeOnlineTrack, &syncJob.fetched);
+
+    syncJob.client.reset(new BearSSL::WiFiClientSecure);
+    syncJob.client->setInsecure();
+    HTTPClient &https = syncJob.https;
+    // HTTP/1.0 so the body is never chunked and can be parsed straight from
+    // the client stream.
+    https.useHTTP10(true);
+    printLog(__func__, LOG_INFO, "[HTTPS] begin...");
+    if (!https.begin(
+            *syncJob.client,
             F("https://connect.midi-agency.com/module/tracks?id_module=") +
                 idModule)) {
-        // HTTP header has been send and Server response header has been handled
-        int httpCode = https.GET();
-        printLog(__func__, LOG_INFO, "[HTTPS] GET... code: " + httpCode);
+        fetchEnd();
+        return false;
+    }
+    // HTTP header has been send and Server response header has been handled
+    int httpCode = https.GET();
+    printLog(__func__, LOG_INFO, "[HTTPS] GET... code: %d", httpCode);
+    // file found at server
+    if (httpCode != HTTP_CODE_OK && httpCode != HTTP_CODE_MOVED_PERMANENTLY) {
+        printLog(__func__, LOG_ERROR, "[HTTPS] GET... failed, error: %s",
+                 https.errorToString(httpCode).c_str());
+        fetchEnd();
+        return false;
+    }
+    syncJob.len = https.getSize();
+    syncJob.last_data_ms = millis();
+    return true;
+}
 
-        // file found at server
-        if (httpCode == HTTP_CODE_OK ||
-            httpCode == HTTP_CODE_MOVED_PERMANENTLY) {
-            payload = https.getString();
-            Serial.println(payload);
-        } else {
-            printLog(__func__, LOG_ERROR, "[HTTPS] GET... failed, error: %s\n",
-                     https.errorToString(httpCode).c_str());
+// Feeds the parser what the client already holds, within the budgets
+DOWNLOAD_STATUS fetchStep(const size_t &budget_bytes, const uint32_t &budget_ms) {
+    uint32_t slice_start_ms = millis();
+    size_t done = 0;
+    uint8_t buff[128];
+    CatalogueParser &parser = syncJob.parser;
+    while ((syncJob.len > 0 || syncJob.len == -1) && !parser.isDone() &&
+           !parser.hasError()) {
+        size_t available = syncJob.client->available();
+        if (!available) {
+            if (!syncJob.https.connected()) return DOWNLOAD_STATUS::DOWNLOAD_DONE;
+            if (millis() - syncJob.last_data_ms >= DOWNLOAD_READ_TIMEOUT_MS) {
+                printLog(__func__, LOG_WARNING, "read timeout");
+                return DOWNLOAD_STATUS::DOWNLOAD_FAILED;
+            }
+            return DOWNLOAD_STATUS::DOWNLOAD_IN_PROGRESS;
         }
+        size_t toRead = std::min(available, sizeof(buff));
+        if (syncJob.len > 0) toRead = std::min(toRead, (size_t)syncJob.len);
+        int c = syncJob.client->read(buff, toRead);
+        if (c <= 0) return DOWNLOAD_STATUS::DOWNLOAD_IN_PROGRESS;
+        syncJob.last_data_ms = millis();
+        parser.feed(buff, c);
+        if (syncJob.len > 0) {
+            syncJob.len -= c;
+        }
+
+        done += c;
+        if (done >= budget_bytes || millis() - slice_start_ms >= budget_ms)
+            return DOWNLOAD_STATUS::DOWNLOAD_IN_PROGRESS;
     }
-    https.end();
-    if (payload.indexOf("\"is_error\":false") != -1) {
-        int lastIndex = 0;
-        int index = 0;
-        String delayMinSet_str =
-            payload.substring(payload.indexOf("\"delayMin\":") + 11,
-                              payload.indexOf(",\"delaySec\":", lastIndex));
-        String delaySecSet_str =
-            payload.substring(payload.indexOf("\"delaySec\":") + 11,
-                              payload.indexOf(",\"delayBefSec\":", lastIndex));
-        String delayBefSecSet_str =
-            payload.substring(payload.indexOf("\"delayBefSec\":") + 14,
-                              payload.indexOf(",\"data\":", lastIndex));
-        delayMinSet = delayMinSet_str.toInt();
-        delaySecSet = delaySecSet_str.toInt();
-        delayBefSecSet = delayBefSecSet_str.toInt();
-        capteur->updateDelay(delayMinSet, delaySecSet);
-        while (true) {
-            if (payload.indexOf("\"id\":", lastIndex + 1) != -1) {
-                lastIndex = payload.indexOf("\"id\":", lastIndex + 1);
-
-                String id = payload.substring(
-                    payload.indexOf("\"id\":", lastIndex - 1) + 5,
-                    payload.indexOf(",\"t\":", lastIndex));
-                String title =
-                    payload.substring(payload.indexOf("\"t\":", lastIndex) + 5,
-                                      payload.indexOf("\",\"s\":", lastIndex));
-                String size =
-                    payload.substring(payload.indexOf("\"s\":", lastIndex) + 4,
-                                      payload.indexOf("\"}", lastIndex));
-                int idNum = id.toInt();
-                int sizeNum = size.toInt();
-                if (title.indexOf("\\") >= 0)
-                    title = title.substring(0, title.indexOf("\\")) +
-                            title.substring(title.indexOf("\\") + 1);
-                allSoundsOnline[index].title = title;
-                allSoundsOnline[index].size = sizeNum;
-                allSoundsOnline[index++].id = idNum;
-            } else
-                break;
+    return DOWNLOAD_STATUS::DOWNLOAD_DONE;
+}
+
+// Applies the settings of the catalogue read. False, allSoundsOnline empty,
+// unless the whole catalogue was read.
+bool fetchEnd() {
+    syncJob.https.end();
+    // Downloads go back to HTTP/1.1, as before the catalogue
+    syncJob.https.useHTTP10(false);
+    // Frees the TLS buffers until the first download
+    syncJob.client.reset();
+    CatalogueParser &parser = syncJob.parser;
+    if (parser.isValid()) {
+        delayMinSet = parser.delayMin();
+        delaySecSet = parser.delaySec();
+        delayBefSecSet = parser.delayBefSec();
+        for (uint8_t i = 0; i < dispatcher.size(); i++) {
+            dispatcher.poste(i).capteur->updateDelay(delayMinSet, delaySecSet);
+            dispatcher.poste(i).capteur->updateHold(parser.holdMs(), parser.releaseMs(), parser.debounceMs());
+        }
+        traceRecorder.delay(delayMinSet, delaySecSet);
+        printLog(__func__, LOG_INFO, "done fetching");
+    } else {
+        for (unsigned char i = 0; i < syncJob.fetched; ++i) {
+            allSoundsOnline[i].title = "";
+            allSoundsOnline[i].size = 0;
+            allSoundsOnline[i].id = 0;
         }
-        Serial.println("done fetching");
-    } else
-        Serial.println(F("is_error = true"));
+        printLog(__func__, LOG_ERROR, "is_error = true");
+    }
+    return parser.isValid();
 }
 
 void fetchAudiosLocal() {
@@ -541,6 +1345,7 @@ void fetchAudiosLocal() {
         if (strcmp(entry.name(), "System Volume Information") == 0) continue;
         if (entry.name()[0] == '.') continue;
         if (strcmp(entry.name(), "waiting.mp3") == 0) continue;
+        if (strcmp(entry.name(), TRACE_PATH + 1) == 0) continue;
         printLog(__func__, LOG_INFO, "%s \t %d", entry.name(), entry.size());
 
         allSoundsStored[index].path = entry.fullName();
@@ -550,7 +1355,22 @@ void fetchAudiosLocal() {
         entry.close();
     }
     max_sound = index;
-    capteur->setMaxSound(max_sound);
+    assignPlaylists();
+}
+
+// Gives each poste the stored tracks whose title starts with its prefix
+void assignPlaylists() {
+    uint8_t tracks[NB_SON];
+    for (uint8_t p = 0; p < dispatcher.size(); p++) {
+        Poste &poste = dispatcher.poste(p);
+        uint8_t count = 0;
+        for (uint8_t i = 0; i < max_sound; i++) {
+            if (allSoundsStored[i].title.startsWith(poste.prefix)) {
+                tracks[count++] = i;
+            }
+        }
+        poste.capteur->setPlaylist(tracks, count);
+    }
 }
 
 void deleteTooMuch() {
@@ -578,61 +1398,16 @@ void deleteTooMuch() {
     }
     for (unsigned int i = 0; i < NB_SON; ++i)
         allSoundsStored[i] = newAllSoundStored[i];
+
+    // Playback goes on while the rest of the sync runs: keep the playlist
+    // bounds in line with what is left on the card.
+    max_sound = 0;
+    while (max_sound < NB_SON && allSoundsStored[max_sound].title != "")
+        max_sound++;
+    assignPlaylists();
 }
 
-void updateAudios() {
-    t_sound newAllSoundStored[NB_SON];
-    unsigned char index = 0;
-    // Checking des sons à update
-    for (unsigned char online = 0; online < NB_SON; ++online) {
-        bool toUpdate = true;
-        if (allSoundsOnline[online].title == "") break;
-        for (unsigned char stored = 0; stored < NB_SON; ++stored) {
-            // Si dans les fichiers locaux, on a déjà le fichier online
-            // correspondant, on copie les info si nécessaire et on passe.
-            // Sinon, on lève un flag 'toUpdate'
-            if (allSoundsOnline[online].title ==
-                allSoundsStored[stored].title) {
-                newAllSoundStored[index] =
-                    allSoundsStored[stored];  // On copie l'ancien dans le
-                                              // nouveau
-                newAllSoundStored[index++].id =
-                    allSoundsOnline[online].id;  // On rajoute l'id
-                toUpdate = false;
-                break;
-            }
-        }
-        // Si il faut downloader le son en ligne pour l'avoir en local
-        if (toUpdate) {
-            Serial.println(F("--------- TOUPDATE ---------"));
-            Serial.println(F("allSoundsOnline[online]"));
-            Serial.println(allSoundsOnline[online].id);
-            Serial.println(allSoundsOnline[online].title);
-            Serial.println(allSoundsOnline[online].path);
-            // On télécharge le son, puis on update les différentes infos
-            if (downloadAudio(allSoundsOnline[online]) == 0) {
-                if (checkSoundIntegrity(allSoundsOnline[online],
-                                        "/" + allSoundsOnline[online].title) ==
-                    0) {
-                    newAllSoundStored[index].id = allSoundsOnline[online].id;
-                    newAllSoundStored[index].size =
-                        allSoundsOnline[online].size;
-                    newAllSoundStored[index].path =
-                        "/" + allSoundsOnline[online].title;
-                    newAllSoundStored[index++].title =
-                        allSoundsOnline[online].title;
-                    printLog(__func__, LOG_INFO, "Audio properly installed");
-                } else {
-                    printLog(__func__, LOG_ERROR,
-                             "Audio was deleted because not complete");
-                }
-            } else
-                printLog(__func__, LOG_ERROR, "Audio could not be downloaded");
-        } else {
-            checkSoundIntegrity(allSoundsOnline[online],
-                                         "/" + allSoundsOnline[online].title);
-        }
-    }
+void commitAudios() {
     // Enfin, il faut supprimer les sons qui sont en trop en comparant
     // l'ancienne liste et la nouvelle. Si on trouve un son de l'ancienne liste
     // dans la nouvelle, on passe. Sinon, c'est que ce son n'existe plus dans la
@@ -641,7 +1416,7 @@ void updateAudios() {
         bool stillThere = false;
         for (unsigned char newList = 0; newList < NB_SON; ++newList) {
             if (allSoundsStored[previous].title ==
-                newAllSoundStored[newList].title) {
+                syncJob.newAllSoundStored[newList].title) {
                 stillThere = true;
                 break;
             }
@@ -650,24 +1425,21 @@ void updateAudios() {
     }
 
     for (unsigned char i = 0; i < NB_SON; ++i)
-        allSoundsStored[i] = newAllSoundStored[i];
-    max_sound = index;
-    capteur->setMaxSound(max_sound);
+        allSoundsStored[i] = syncJob.newAllSoundStored[i];
+    max_sound = syncJob.index;
+    assignPlaylists();
 }
 
 int checkSoundIntegrity(t_sound toCheck, String path) {
-    Serial.print("path: ");
-    Serial.println(path);
     File f = SD.open(path, FILE_READ);
     int sizeFile = f.size();
     f.close();
-    Serial.print("sizeFile: ");
-    Serial.println(sizeFile);
-    Serial.print("toCheck.size: ");
-    Serial.println(toCheck.size);
+    printLog(__func__, LOG_INFO, "path: %s sizeFile: %d toCheck.size: %d",
+             path.c_str(), sizeFile, toCheck.size);
     if (sizeFile == toCheck.size)
         return 0;
     else {
+        releaseTrackSource();
         if (SD.remove(path)) {
             printLog(__func__, LOG_WARNING, "Son incomplet supprimé avec succès");
             return -1;
@@ -680,10 +1452,11 @@ int checkSoundIntegrity(t_sound toCheck, String path) {
 }
 
 int removeAudio(String filename) {
+    releaseTrackSource();
     File dataFile = SD.open(filename, FILE_READ);
     if (dataFile) {
         if (SD.remove(filename)) {
-            Serial.println(F("Son supprimé avec succès"));
+            printLog(__func__, LOG_INFO, "Son supprimé avec succès");
         } else {
             printLog(__func__, LOG_ERROR, "Erreur lors de la suppression du son");
             return -1;
@@ -696,17 +1469,15 @@ int removeAudio(String filename) {
     return 0;
 }
 
-int downloadAudio(t_sound soundToUpdade) {
-    std::unique_ptr<BearSSL::WiFiClientSecure> client(
-        new BearSSL::WiFiClientSecure);
-    client->setInsecure();
-    HTTPClient https;
+int downloadBegin(const t_sound &soundToUpdade) {
+    syncJob.client.reset(new BearSSL::WiFiClientSecure);
+    syncJob.client->setInsecure();
+    HTTPClient &https = syncJob.https;
     String path_brute;
     String URL = "https://connect.midi-agency.com/module/track/path?id=";
     URL += soundToUpdade.id;
-    Serial.print("URL: ");
-    Serial.println(URL);
-    if (https.begin(*client, URL)) {
+    printLog(__func__, LOG_INFO, "URL: %s", URL.c_str());
+    if (https.begin(*syncJob.client, URL)) {
         // HTTP header has been send and Server response header has been handled
         int httpCode = https.GET();
 
@@ -715,72 +1486,116 @@ int downloadAudio(t_sound soundToUpdade) {
             httpCode == HTTP_CODE_MOVED_PERMANENTLY) {
             path_brute = https.getString();
         } else {
-            Serial.printf("[HTTPS] GET... failed, error: %s\n",
-                          https.errorToString(httpCode).c_str());
+            printLog(__func__, LOG_ERROR, "[HTTPS] GET... failed, error: %s",
+                     https.errorToString(httpCode).c_str());
         }
     }
     https.end();
 
     path_brute = path_brute.substring(1, path_brute.indexOf("\"", 5));
     path_brute.replace("\\", "");
-    Serial.println(path_brute);
-
-    // String URL = F("https://connect.midi-agency.com/");
-    // URL += soundToUpdade.path;
-    // Serial.println(soundToUpdade.path);
-    Serial.print(F("[HTTPS] begin...\n"));
-    if (https.begin(*client,
-                    F("https://connect.midi-agency.com/") + path_brute)) {
-        Serial.println(F("[HTTPS] GET...\n"));
-        // start connection and send HTTP header
-        int httpCode = https.GET();
-        Serial.print(F("HTTP Code: "));
-        Serial.println(httpCode);
-        // httpCode will be negative on error
-        if (httpCode > 0) {
-            String audioName = soundToUpdade.title;
-            // if (audioName.indexOf("\\") >= 0)
-            //   audioName = audioName.substring(0,audioName.indexOf("\\")) +
-            //   audioName.substring(audioName.indexOf("\\")+1);
-            // soundToUpdade.title = audioName;
-            Serial.print(F("audioName: "));
-            Serial.println(audioName);
-            File f = SD.open(audioName, FILE_WRITE);
-            // read all data from server
-            if (f) {
-                int len = https.getSize();
-                uint8_t buff[128] = {0};
-                int nbBytes = 0;
-                bool blink = false;
-                while (https.connected() && (len > 0 || len == -1)) {
-                    // read up to 128 byte
-                    int c = client->readBytes(
-                        buff, std::min((size_t)len, sizeof(buff)));
-                    f.write(buff, c);
-                    if (++nbBytes % 100 == 0)
-                        Serial.printf("NE PAS DEBRANCHER\n\tnbBytes: %d\n",
-                                      nbBytes);
-
-                    if (nbBytes % 10 == 0) {
-                        digitalWrite(LED_BUILTIN, blink);
-                        blink = !blink;
-                    }
-                    if (!c) {
-                        Serial.println(F("read timeout"));
-                    }
-
-                    if (len > 0) {
-                        len -= c;
-                    }
-                }
-                Serial.println("done");
-                f.close();
-            } else
-                return -1;
-        } else
-            return -1;
-    } else
+    printLog(__func__, LOG_INFO, "path: %s", path_brute.c_str());
+
+    printLog(__func__, LOG_INFO, "[HTTPS] begin...");
+    if (!https.begin(*syncJob.client,
+                     F("https://connect.midi-agency.com/") + path_brute)) {
+        syncJob.client.reset();
         return -1;
-    https.end();
+    }
+    // start connection and send HTTP header
+    int httpCode = https.GET();
+    printLog(__func__, LOG_INFO, "[HTTPS] GET... code: %d", httpCode);
+    // httpCode will be negative on error
+    if (httpCode <= 0) {
+        https.end();
+        syncJob.client.reset();
+        return -1;
+    }
+    printLog(__func__, LOG_INFO, "audioName: %s", soundToUpdade.title.c_str());
+    syncJob.file = SD.open(soundToUpdade.title, FILE_WRITE);
+    if (!syncJob.file) {
+        https.end();
+        syncJob.client.reset();
+        return -1;
+    }
+    syncJob.metrics = DownloadMetrics();
+    syncJob.writer.begin(&syncJob.file, &syncJob.metrics);
+    syncJob.len = https.getSize();
+    syncJob.start_ms = millis();
+    syncJob.last_data_ms = syncJob.start_ms;
+    syncJob.last_progress_ms = syncJob.start_ms;
+    syncJob.consecutive_timeouts = 0;
+    syncJob.stalled = false;
     return 0;
-}
\ No newline at end of file
+}
+
+DOWNLOAD_STATUS downloadStep(const size_t &budget_bytes, const uint32_t &budget_ms) {
+    uint32_t slice_start_ms = millis();
+    size_t done = 0;
+    while (syncJob.len > 0 || syncJob.len == -1) {
+        // Only take what the client already holds, the network keeps filling
+        // its buffer between slices.
+        size_t available = syncJob.client->available();
+        if (!available) {
+            if (!syncJob.https.connected()) return DOWNLOAD_STATUS::DOWNLOAD_DONE;
+            if (!syncJob.stalled) {
+                syncJob.stalled = true;
+                syncJob.stall_start_ms = millis();
+            }
+            if (millis() - syncJob.last_data_ms >= DOWNLOAD_READ_TIMEOUT_MS) {
+                printLog(__func__, LOG_WARNING, "read timeout");
+                syncJob.metrics.read_timeouts++;
+                syncJob.last_data_ms = millis();
+                if (++syncJob.consecutive_timeouts >= DOWNLOAD_MAX_READ_TIMEOUTS)
+                    return DOWNLOAD_STATUS::DOWNLOAD_FAILED;
+            }
+            return DOWNLOAD_STATUS::DOWNLOAD_IN_PROGRESS;
+        }
+        if (syncJob.stalled) {
+            syncJob.metrics.stall_ms += millis() - syncJob.stall_start_ms;
+            syncJob.stalled = false;
+        }
+
+        size_t toRead = std::min(available, syncJob.writer.room());
+        toRead = std::min(toRead, budget_bytes - done);
+        if (syncJob.len > 0) toRead = std::min(toRead, (size_t)syncJob.len);
+        int c = syncJob.client->read(syncJob.writer.tail(), toRead);
+        if (c <= 0) return DOWNLOAD_STATUS::DOWNLOAD_IN_PROGRESS;
+        syncJob.consecutive_timeouts = 0;
+        syncJob.last_data_ms = millis();
+        if (!syncJob.writer.commit(c)) return DOWNLOAD_STATUS::DOWNLOAD_FAILED;
+        if (syncJob.len > 0) {
+            syncJob.len -= c;
+        }
+
+        if (millis() - syncJob.last_progress_ms >= DOWNLOAD_PROGRESS_MS) {
+            syncJob.last_progress_ms = millis();
+            printLog(__func__, LOG_INFO, "NE PAS DEBRANCHER nbBytes: %u",
+                     syncJob.metrics.bytes);
+            digitalWrite(LED_BUILTIN, syncJob.blink);
+            syncJob.blink = !syncJob.blink;
+        }
+
+        done += c;
+        if (done >= budget_bytes || millis() - slice_start_ms >= budget_ms)
+            return DOWNLOAD_STATUS::DOWNLOAD_IN_PROGRESS;
+    }
+    return DOWNLOAD_STATUS::DOWNLOAD_DONE;
+}
+
+void downloadEnd() {
+    syncJob.writer.finish();
+    if (syncJob.stalled) {
+        syncJob.metrics.stall_ms += millis() - syncJob.stall_start_ms;
+        syncJob.stalled = false;
+    }
+    syncJob.metrics.duration_ms = millis() - syncJob.start_ms;
+    syncJob.metrics.log(syncJob.file.name());
+    lastDownloadMetrics = syncJob.metrics;
+    download_bytes.inc(syncJob.metrics.bytes);
+    printLog(__func__, LOG_INFO, "done");
+    syncJob.file.close();
+    syncJob.https.end();
+    // Frees the TLS buffers until the next download
+    syncJob.client.reset();
+}
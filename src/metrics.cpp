@@ -0,0 +1,77 @@
+#include "metrics.hpp"
+
+#include "fmt.hpp"
+#include "log.hpp"
+
+static const char* TYPE_NAMES_[] = {"counter", "gauge", "histogram"};
+
+// Not every printf of the cores has %llu
+static const char* formatU64_(char* digits, const size_t& size, uint64_t value) {
+    size_t pos = size - 1;
+    digits[pos] = '\0';
+    do {
+        digits[--pos] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0 && pos > 0);
+    return digits + pos;
+}
+
+size_t Metric::writeSample_(char* out, const size_t& size, size_t len, const char* suffix, const char* le,
+                            const uint64_t& value) const {
+    char digits[21];
+    len = appendFormat(out, size, len, "%s%s", name, suffix);
+    if (labels && le) {
+        len = appendFormat(out, size, len, "{%s,le=\"%s\"}", labels, le);
+    } else if (labels || le) {
+        len = appendFormat(out, size, len, labels ? "{%s}" : "{le=\"%s\"}", labels ? labels : le);
+    }
+    return appendFormat(out, size, len, " %s\n", formatU64_(digits, sizeof(digits), value));
+}
+
+size_t Counter::write(char* out, const size_t& size, size_t len) const {
+    return writeSample_(out, size, len, "", nullptr, value_);
+}
+
+size_t Gauge::write(char* out, const size_t& size, size_t len) const {
+    return writeSample_(out, size, len, "", nullptr, value_);
+}
+
+Histogram::Histogram(const char* name, const char* help, const uint32_t* bounds, const uint8_t& nb_bounds,
+                     const char* labels)
+    : Metric(name, help, labels), bounds_(bounds),
+      nb_bounds_(nb_bounds < HISTOGRAM_MAX_BUCKETS ? nb_bounds : HISTOGRAM_MAX_BUCKETS) {}
+
+size_t Histogram::write(char* out, const size_t& size, size_t len) const {
+    // Buckets are cumulative in the exposition format
+    uint32_t count = 0;
+    char le[12];
+    for (uint8_t i = 0; i < nb_bounds_; i++) {
+        count += counts_[i];
+        snprintf(le, sizeof(le), "%u", bounds_[i]);
+        len = writeSample_(out, size, len, "_bucket", le, count);
+    }
+    count += counts_[nb_bounds_];
+    len = writeSample_(out, size, len, "_bucket", "+Inf", count);
+    len = writeSample_(out, size, len, "_sum", nullptr, sum_);
+    return writeSample_(out, size, len, "_count", nullptr, count);
+}
+
+bool Metrics::add(Metric& metric) {
+    if (nb_metrics_ == METRICS_MAX) {
+        printLog(__func__, LOG_ERROR, "%d metrics max, %s not added", METRICS_MAX, metric.name);
+        return false;
+    }
+    metrics_[nb_metrics_++] = &metric;
+    return true;
+}
+
+size_t Metrics::write(const uint8_t& index, char* out, const size_t& size) const {
+    const Metric& metric = *metrics_[index];
+    size_t len = 0;
+    out[0] = '\0';
+    if (index == 0 || strcmp(metrics_[index - 1]->name, metric.name) != 0) {
+        len = appendFormat(out, size, len, "# HELP %s %s\n# TYPE %s %s\n", metric.name, metric.help, metric.name,
+                      TYPE_NAMES_[metric.type()]);
+    }
+    return metric.write(out, size, len);
+}
@@ -1,59 +1,42 @@
 #include "pir.hpp"
 
-#define MIN_LOOP 10000
-#define MIN_LOOP_2 100
-
-extern void printLog(const char* function, LOG_LEVEL level, const char* message,
-                     ...);
+// Release windows of the "while" scenarios, unless set by the server
+#define RELEASE_MS_MOVE 3000
+#define RELEASE_MS_NO_MOVE 1000
 
 Pir::Pir(const int& delayMin, const int& delaySec, const uint8_t& pin, const int& scenario)
 :Capteur(delayMin, delaySec, pin, scenario)
 {
+    input_.begin(pin_);
 }
 
 Pir::~Pir()
 {
 }
 
-bool Pir::isTriggered(uint32_t &minutes_since_act, uint8_t &seconds_since_act, uint32_t seconds_since_boot_act_timestamp, const uint32_t &seconds_since_boot, PLAYER_STATE &player_state) {
+bool Pir::isTriggered(const uint64_t &now_ms, PLAYER_STATE &player_state) {
+    input_.update();
+
     switch (scenario_)
     {
     case PIR_SCENARIO::PLAY_ONCE_WHEN_MOVE:
-        if (((minutes_since_act * 60 + seconds_since_act >= delayMin_ * 60 + delaySec_) && digitalRead (pin_)) || player_state == PLAYER_STATE::PLAYING)
+        if ((isReady_(now_ms) && input_.high()) || player_state == PLAYER_STATE::PLAYING)
             return true;
         else return false;
         break;
 
     case PIR_SCENARIO::PLAY_WHILE_MOVE:
-        if (((minutes_since_act >= delayMin_ && seconds_since_act >= delaySec_)  && digitalRead (pin_)) || (running_ && loops_since_act_ < MIN_LOOP)) {
-            running_ = true;
-            if (digitalRead (pin_)) loops_since_act_ = 0;
-            loops_since_act_ ++;
-            return true;
-        }
-        else {
-            running_ = false;
-            return false;
-        }
+        return whilePresent_(now_ms, input_.high(), isReady_(now_ms), RELEASE_MS_MOVE);
         break;
 
     case PIR_SCENARIO::PLAY_ONCE_WHEN_NO_MOVE:
-        if (((minutes_since_act >= delayMin_ && seconds_since_act >= delaySec_) && !digitalRead (pin_)) || player_state == PLAYER_STATE::PLAYING)
+        if ((isReady_(now_ms) && input_.low()) || player_state == PLAYER_STATE::PLAYING)
             return true;
         else return false;
         break;
 
     case PIR_SCENARIO::PLAY_WHILE_NO_MOVE:
-        if (((minutes_since_act >= delayMin_ && seconds_since_act >= delaySec_)  && !digitalRead (pin_)) || (running_ && loops_since_act_ < MIN_LOOP_2)) {
-            running_ = true;
-            if (!digitalRead(pin_)) loops_since_act_ = 0;
-            loops_since_act_ ++;
-            return true;
-        }
-        else {
-            running_ = false;
-            return false;
-        }
+        return whilePresent_(now_ms, input_.low(), isReady_(now_ms), RELEASE_MS_NO_MOVE);
         break;
 
     default:
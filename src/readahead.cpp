@@ -0,0 +1,147 @@
+#include "readahead.hpp"
+
+#include "log.hpp"
+
+void ReadAheadMetrics::log(const char* title) const {
+    printLog(__func__, LOG_INFO, "%s: %u reads, %u%% from RAM, %u refills of %u us on average, %u us max",
+             title, reads, hitPercent(), refills, refills ? refill_us / refills : 0, refill_max_us);
+}
+
+bool ReadAheadSource::open(const char* path) {
+    close();
+    file_ = SD.open(path);
+    if (!file_) {
+        printLog(__func__, LOG_ERROR, "Cannot open %s", path);
+        return false;
+    }
+    strncpy(path_, path, sizeof(path_) - 1);
+    path_[sizeof(path_) - 1] = '\0';
+
+    // ID3v2 header: "ID3", version, flags, then a syncsafe size that
+    // counts neither the header nor the footer
+    uint8_t header[ID3_HEADER_SIZE];
+    if (file_.read(header, sizeof(header)) == sizeof(header) && header[0] == 'I' && header[1] == 'D' &&
+        header[2] == '3') {
+        start_ = ID3_HEADER_SIZE + ((uint32_t)(header[6] & 0x7F) << 21 | (uint32_t)(header[7] & 0x7F) << 14 |
+                                    (uint32_t)(header[8] & 0x7F) << 7 | (header[9] & 0x7F));
+        if (header[5] & 0x10) {
+            start_ += ID3_HEADER_SIZE;
+        }
+        if (start_ > file_.size()) {
+            start_ = 0;
+        }
+    }
+    uint32_t offset = start_ - start_ % READAHEAD_SECTOR_SIZE;
+    fill_(buffers_[0], offset, false);
+    fill_(buffers_[1], offset + READAHEAD_BUFFER_SIZE, false);
+    metrics_ = ReadAheadMetrics();
+    return true;
+}
+
+uint32_t ReadAheadSource::read(void* data, uint32_t len) {
+    uint8_t* out = static_cast<uint8_t*>(data);
+    uint32_t done = 0;
+    bool hit = true;
+    while (done < len && file_ && start_ + pos_ < file_.size()) {
+        uint32_t at = start_ + pos_;
+        Buffer* buffer = find_(at);
+        if (buffer == nullptr) {
+            // After a seek, or loop() could not keep up
+            hit = false;
+            buffer = &buffers_[0];
+            if (!fill_(*buffer, at - at % READAHEAD_SECTOR_SIZE) || !buffer->holds(at)) {
+                break;  // end of file
+            }
+        }
+        uint32_t chunk = buffer->offset + buffer->len - at;
+        if (chunk > len - done) {
+            chunk = len - done;
+        }
+        memcpy(out + done, buffer->data + (at - buffer->offset), chunk);
+        done += chunk;
+        pos_ += chunk;
+    }
+    metrics_.reads++;
+    if (hit) {
+        metrics_.hits++;
+    }
+    return done;
+}
+
+bool ReadAheadSource::loop() {
+    if (!file_) {
+        return true;
+    }
+    uint32_t at = start_ + pos_;
+    Buffer* current = find_(at);
+    if (current == nullptr) {
+        return true;  // read() refills it
+    }
+    Buffer& other = current == &buffers_[0] ? buffers_[1] : buffers_[0];
+    uint32_t next = current->offset + current->len;
+    if (other.offset != next && current->len == READAHEAD_BUFFER_SIZE && next < file_.size()) {
+        fill_(other, next);
+    }
+    return true;
+}
+
+bool ReadAheadSource::seek(int32_t pos, int dir) {
+    if (!file_) {
+        return false;
+    }
+    int64_t target = pos;
+    if (dir == SEEK_CUR) {
+        target += pos_;
+    } else if (dir == SEEK_END) {
+        target += getSize();
+    }
+    if (target < 0 || target > getSize()) {
+        return false;
+    }
+    pos_ = target;
+    return true;
+}
+
+bool ReadAheadSource::close() {
+    file_.close();
+    path_[0] = '\0';
+    start_ = 0;
+    pos_ = 0;
+    for (Buffer& buffer : buffers_) {
+        buffer.len = 0;
+    }
+    return true;
+}
+
+ReadAheadSource::Buffer* ReadAheadSource::find_(const uint32_t& at) {
+    for (Buffer& buffer : buffers_) {
+        if (buffer.holds(at)) {
+            return &buffer;
+        }
+    }
+    return nullptr;
+}
+
+bool ReadAheadSource::fill_(Buffer& buffer, const uint32_t& offset, const bool& measured) {
+    uint32_t start_us = micros();
+    buffer.len = 0;
+    if (file_.position() != offset && !file_.seek(offset)) {
+        return false;
+    }
+    int len = file_.read(buffer.data, READAHEAD_BUFFER_SIZE);
+    buffer.offset = offset;
+    buffer.len = len > 0 ? len : 0;
+    if (!measured) {
+        return buffer.len > 0;
+    }
+    uint32_t elapsed_us = micros() - start_us;
+    metrics_.refills++;
+    metrics_.refill_us += elapsed_us;
+    if (elapsed_us > metrics_.refill_max_us) {
+        metrics_.refill_max_us = elapsed_us;
+    }
+    if (refill_duration_) {
+        refill_duration_->observe(elapsed_us);
+    }
+    return buffer.len > 0;
+}
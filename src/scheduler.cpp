@@ -0,0 +1,96 @@
+#include "scheduler.hpp"
+
+static void wakeTask_(void* ctx) {
+    static_cast<Task*>(ctx)->ready = true;
+}
+
+Task::Task(const char* name, Run run, const uint8_t& priority, const uint32_t& period_ms, void* ctx)
+    : name(name), run(run), ctx(ctx), priority(priority), period_ms(period_ms), wake(wakeTask_, this) {}
+
+bool Scheduler::add(Task& task) {
+    if (nb_tasks_ == SCHEDULER_MAX_TASKS) {
+        printLog(__func__, LOG_ERROR, "%d tasks max, %s not added", SCHEDULER_MAX_TASKS, task.name);
+        return false;
+    }
+    // Sorted by priority, in the order they were added within one
+    uint8_t index = nb_tasks_;
+    while (index > 0 && tasks_[index - 1]->priority > task.priority) {
+        tasks_[index] = tasks_[index - 1];
+        index--;
+    }
+    tasks_[index] = &task;
+    nb_tasks_++;
+    return true;
+}
+
+void Scheduler::run() {
+    for (uint8_t i = 0; i < nb_tasks_; i++) {
+        Task& task = *tasks_[i];
+        if (!task.ready) {
+            continue;
+        }
+        run_(task, i);
+        if (task.priority == SCHEDULER_CRITICAL) {
+            continue;
+        }
+        for (uint8_t j = 0; j < nb_tasks_ && tasks_[j]->priority == SCHEDULER_CRITICAL; j++) {
+            if (tasks_[j]->ready) {
+                run_(*tasks_[j], j);
+            }
+        }
+    }
+}
+
+void Scheduler::sleep(Task& task, const uint32_t& ms) {
+    task.ready = false;
+    timers_.schedule(task.wake, ms);
+}
+
+void Scheduler::suspend(Task& task) {
+    task.ready = false;
+    task.suspended = true;
+    timers_.cancel(task.wake);
+}
+
+void Scheduler::wake(Task& task) {
+    task.suspended = false;
+    task.ready = true;
+    timers_.cancel(task.wake);
+}
+
+void Scheduler::report() const {
+    uint64_t uptime_us = (uint64_t)timers_.now() * 1000;
+    for (uint8_t i = 0; i < nb_tasks_; i++) {
+        const Task& task = *tasks_[i];
+        uint32_t permille = uptime_us > 0 ? task.busy_us * 1000 / uptime_us : 0;
+        printLog(__func__, LOG_INFO, "%s: %u runs, %u ms busy (%u.%u%%), max %u us", task.name,
+                 task.runs, (uint32_t)(task.busy_us / 1000), permille / 10, permille % 10, task.max_us);
+    }
+}
+
+void Scheduler::run_(Task& task, const uint8_t& index) {
+    // A periodic task waits for its timer, unless run() calls wake()
+    task.ready = task.period_ms == 0;
+    if (stalls_) {
+        stalls_->enter(index);
+    }
+    uint32_t start_us = micros();
+    task.run(task.ctx);
+    uint32_t elapsed_us = micros() - start_us;
+    if (stalls_) {
+        stalls_->exit();
+    }
+
+    task.runs++;
+    task.busy_us += elapsed_us;
+    if (elapsed_us > task.max_us) {
+        task.max_us = elapsed_us;
+    }
+    if (task.duration) {
+        task.duration->observe(elapsed_us);
+    }
+    // Unless run() chose its own wakeup
+    if (task.period_ms > 0 && !task.ready && !task.suspended && !task.wake.armed) {
+        timers_.schedule(task.wake, task.period_ms);
+    }
+}
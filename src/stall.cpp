@@ -0,0 +1,95 @@
+#include "stall.hpp"
+
+#include "log.hpp"
+
+#define STALL_RTC_PHASE (STALL_RTC_OFFSET + 1)
+#define STALL_RTC_COUNT (STALL_RTC_OFFSET + 2)
+#define STALL_RTC_RECORDS (STALL_RTC_OFFSET + 3)
+
+static_assert(sizeof(StallRecord) % 4 == 0, "RTC memory is written in 4-byte blocks");
+
+void StallDetector::begin(PhaseName phase_name) {
+    phase_name_ = phase_name;
+    const rst_info* info = ESP.getResetInfoPtr();
+    uint32_t reason = info ? info->reason : (uint32_t)REASON_DEFAULT_RST;
+
+    ESP.rtcUserMemoryRead(STALL_RTC_OFFSET, (uint32_t*)&state_, sizeof(state_));
+    // Random after a power-on
+    if (state_.magic != STALL_RTC_MAGIC || reason == REASON_DEFAULT_RST) {
+        state_ = State();
+        state_.magic = STALL_RTC_MAGIC;
+        state_.phase = STALL_PHASE_NONE;
+    }
+    if (reason == REASON_WDT_RST || reason == REASON_SOFT_WDT_RST || reason == REASON_EXCEPTION_RST) {
+        reset_phase_ = state_.phase;
+    }
+    previous_count_ = state_.count < STALL_RECORDS ? state_.count : STALL_RECORDS;
+    ESP.rtcUserMemoryWrite(STALL_RTC_OFFSET, (uint32_t*)&state_, sizeof(state_));
+    enter(STALL_PHASE_SETUP);
+}
+
+void StallDetector::report() const {
+    if (reset_phase_ != STALL_PHASE_NONE) {
+        printLog(__func__, LOG_ERROR, "Reset by watchdog or exception in %s", name_(reset_phase_));
+    }
+    for (uint8_t i = previous_count_; i > 0; i--) {
+        const StallRecord& stall = record(i - 1);
+        printLog(__func__, LOG_WARNING, "Previous stall at %u ms: %u ms, %u ms in %s", stall.at_ms,
+                 stall.iteration_us / 1000, stall.phase_us / 1000, name_(stall.phase));
+    }
+}
+
+void StallDetector::beginIteration() {
+    iteration_start_us_ = micros();
+    worst_us_ = 0;
+    worst_phase_ = STALL_PHASE_NONE;
+}
+
+void StallDetector::enter(const uint8_t& phase) {
+    phase_ = phase;
+    phase_start_us_ = micros();
+    uint32_t word = phase;
+    ESP.rtcUserMemoryWrite(STALL_RTC_PHASE, &word, sizeof(word));
+}
+
+void StallDetector::exit() {
+    uint32_t elapsed_us = micros() - phase_start_us_;
+    if (elapsed_us >= worst_us_) {
+        worst_us_ = elapsed_us;
+        worst_phase_ = phase_;
+    }
+}
+
+void StallDetector::endIteration() {
+    uint32_t elapsed_us = micros() - iteration_start_us_;
+    if (elapsed_us <= budget_us_) {
+        return;
+    }
+    uint8_t slot = state_.count % STALL_RECORDS;
+    StallRecord& stall = state_.records[slot];
+    stall.at_ms = millis();
+    stall.iteration_us = elapsed_us;
+    stall.phase_us = worst_us_;
+    stall.phase = worst_phase_;
+    state_.count++;
+    ESP.rtcUserMemoryWrite(STALL_RTC_RECORDS + slot * sizeof(StallRecord) / 4, (uint32_t*)&stall,
+                           sizeof(stall));
+    ESP.rtcUserMemoryWrite(STALL_RTC_COUNT, &state_.count, sizeof(state_.count));
+    printLog(__func__, LOG_WARNING, "loop() stalled %u ms, %u ms in %s", elapsed_us / 1000, worst_us_ / 1000,
+             name_(worst_phase_));
+}
+
+const StallRecord& StallDetector::record(const uint8_t& index) const {
+    return state_.records[(state_.count - 1 - index) % STALL_RECORDS];
+}
+
+const char* StallDetector::name_(const uint8_t& phase) const {
+    if (phase == STALL_PHASE_SETUP) {
+        return "setup";
+    }
+    if (phase == STALL_PHASE_TIMERS) {
+        return "timers";
+    }
+    const char* name = phase_name_ && phase != STALL_PHASE_NONE ? phase_name_(phase) : nullptr;
+    return name ? name : "?";
+}
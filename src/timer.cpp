@@ -0,0 +1,64 @@
+#include "timer.hpp"
+
+void TimerWheel::advance(const uint64_t& now_ms) {
+    now_ms_ = now_ms;
+    round_++;
+    uint64_t tick = now_ms >> TIMER_WHEEL_TICK_SHIFT;
+    // The current slot is visited again on every call, its deadlines can be
+    // later than now within the tick. Past a full turn every slot is due.
+    uint64_t first = tick - tick_ >= TIMER_WHEEL_SLOTS ? tick - TIMER_WHEEL_SLOTS + 1 : tick_;
+    tick_ = tick;
+    for (uint64_t t = first; t <= tick; t++) {
+        Timer** slot = &slots_[t & (TIMER_WHEEL_SLOTS - 1)];
+        Timer** link = slot;
+        while (*link != nullptr) {
+            Timer* timer = *link;
+            // Armed during this round by a callback: next advance()
+            if (timer->deadline_ms > now_ms || timer->round == round_) {
+                link = &timer->next;
+                continue;
+            }
+            *link = timer->next;
+            timer->armed = false;
+            if (timer->period_ms > 0) {
+                scheduleAt(*timer, now_ms + timer->period_ms);
+            }
+            timer->callback(timer->ctx);
+            // The callback may have changed this slot, start over
+            link = slot;
+        }
+    }
+}
+
+void TimerWheel::schedule(Timer& timer, const uint32_t& delay_ms) {
+    scheduleAt(timer, now_ms_ + delay_ms);
+}
+
+void TimerWheel::scheduleAt(Timer& timer, const uint64_t& deadline_ms) {
+    cancel(timer);
+    // Already due: the current slot, so the next advance() sees it
+    uint64_t tick = deadline_ms >> TIMER_WHEEL_TICK_SHIFT;
+    if (tick < tick_) {
+        tick = tick_;
+    }
+    timer.slot = tick & (TIMER_WHEEL_SLOTS - 1);
+    timer.deadline_ms = deadline_ms;
+    timer.round = round_;
+    timer.armed = true;
+    timer.next = slots_[timer.slot];
+    slots_[timer.slot] = &timer;
+}
+
+void TimerWheel::cancel(Timer& timer) {
+    if (!timer.armed) {
+        return;
+    }
+    for (Timer** link = &slots_[timer.slot]; *link != nullptr; link = &(*link)->next) {
+        if (*link == &timer) {
+            *link = timer.next;
+            break;
+        }
+    }
+    timer.armed = false;
+    timer.next = nullptr;
+}
@@ -0,0 +1,186 @@
+#include "trace.hpp"
+
+#include "log.hpp"
+
+TraceRecorder traceRecorder;
+
+static size_t writeVarint_(uint32_t value, uint8_t* out) {
+    size_t len = 0;
+    while (value >= 0x80) {
+        out[len++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    out[len++] = value;
+    return len;
+}
+
+static size_t readVarint_(const uint8_t* in, size_t len, uint32_t& value) {
+    value = 0;
+    for (size_t i = 0; i < len && i < 5; i++) {
+        value |= (uint32_t)(in[i] & 0x7F) << (7 * i);
+        if (!(in[i] & 0x80)) return i + 1;
+    }
+    return 0;
+}
+
+static void writeU16_(uint16_t value, uint8_t* out) {
+    out[0] = value & 0xFF;
+    out[1] = value >> 8;
+}
+
+static uint16_t readU16_(const uint8_t* in) { return in[0] | (in[1] << 8); }
+
+size_t encodeTraceHeader(const TraceHeader& header, uint8_t* out) {
+    memcpy(out, "MAST", 4);
+    out[4] = TRACE_VERSION;
+    out[5] = header.capteur_type;
+    out[6] = header.scenario;
+    out[7] = 0;
+    writeU16_(header.delay_min, out + 8);
+    writeU16_(header.delay_sec, out + 10);
+    writeU16_(header.min_distance, out + 12);
+    writeU16_(header.time_within_minimum_sec, out + 14);
+    writeU16_(header.time_within_minimum_sec_2, out + 16);
+    return TRACE_HEADER_SIZE;
+}
+
+bool decodeTraceHeader(const uint8_t* in, size_t len, TraceHeader& header) {
+    // Version 1 is version 2 without DELAY records
+    if (len < TRACE_HEADER_SIZE || memcmp(in, "MAST", 4) != 0 || in[4] < 1 || in[4] > TRACE_VERSION) {
+        return false;
+    }
+    header.capteur_type = in[5];
+    header.scenario = in[6];
+    header.delay_min = readU16_(in + 8);
+    header.delay_sec = readU16_(in + 10);
+    header.min_distance = readU16_(in + 12);
+    header.time_within_minimum_sec = readU16_(in + 14);
+    header.time_within_minimum_sec_2 = readU16_(in + 16);
+    return true;
+}
+
+size_t encodeTraceRecord(const TraceRecord& record, uint32_t& last_ms, uint8_t* out) {
+    size_t len = writeVarint_(record.timestamp_ms - last_ms, out);
+    out[len++] = (record.kind << 6) | ((record.level & 0x01) << 5) | (record.pin & 0x1F);
+    if (record.kind == TRACE_KIND::ECHO) {
+        len += writeVarint_(record.echo_us, out + len);
+    } else if (record.kind == TRACE_KIND::DELAY) {
+        len += writeVarint_(record.delay_min, out + len);
+        len += writeVarint_(record.delay_sec, out + len);
+    }
+    last_ms = record.timestamp_ms;
+    return len;
+}
+
+size_t decodeTraceRecord(const uint8_t* in, size_t len, uint32_t& last_ms, TraceRecord& record) {
+    uint32_t delta_ms;
+    size_t used = readVarint_(in, len, delta_ms);
+    if (used == 0 || used >= len) return 0;
+
+    uint8_t tag = in[used++];
+    record.timestamp_ms = last_ms + delta_ms;
+    record.kind = (TRACE_KIND)(tag >> 6);
+    record.level = (tag >> 5) & 0x01;
+    record.pin = tag & 0x1F;
+    record.echo_us = 0;
+    if (record.kind == TRACE_KIND::ECHO) {
+        size_t echo_len = readVarint_(in + used, len - used, record.echo_us);
+        if (echo_len == 0) return 0;
+        used += echo_len;
+    } else if (record.kind == TRACE_KIND::DELAY) {
+        uint32_t delay_min, delay_sec;
+        size_t min_len = readVarint_(in + used, len - used, delay_min);
+        if (min_len == 0) return 0;
+        used += min_len;
+        size_t sec_len = readVarint_(in + used, len - used, delay_sec);
+        if (sec_len == 0) return 0;
+        used += sec_len;
+        record.delay_min = delay_min;
+        record.delay_sec = delay_sec;
+    }
+    last_ms = record.timestamp_ms;
+    return used;
+}
+
+bool TraceRecorder::begin(const char* path, const TraceHeader& header) {
+    if (SD.exists(path)) SD.remove(path);
+    file_ = SD.open(path, FILE_WRITE);
+    if (!file_) {
+        printLog(__func__, LOG_ERROR, "Cannot open trace file %s", path);
+        return false;
+    }
+    uint8_t raw[TRACE_HEADER_SIZE];
+    file_.write(raw, encodeTraceHeader(header, raw));
+    last_ms_ = 0;
+    pin_levels_ = 0;
+    pins_seen_ = 0;
+    used_ = 0;
+    active_ = true;
+    printLog(__func__, LOG_INFO, "Recording sensor trace to %s", path);
+    return true;
+}
+
+void TraceRecorder::end() {
+    if (!active_) return;
+    flush();
+    file_.close();
+    active_ = false;
+}
+
+void TraceRecorder::pin(const uint8_t& pin, const uint8_t& level) {
+    if (!active_) return;
+    uint32_t mask = 1UL << (pin & 0x1F);
+    bool high = level != LOW;
+    if ((pins_seen_ & mask) && ((pin_levels_ & mask) != 0) == high) return;
+    pins_seen_ |= mask;
+    pin_levels_ = high ? (pin_levels_ | mask) : (pin_levels_ & ~mask);
+
+    TraceRecord record;
+    record.timestamp_ms = millis();
+    record.kind = TRACE_KIND::PIN_LEVEL;
+    record.pin = pin;
+    record.level = high;
+    append_(record);
+}
+
+void TraceRecorder::echo(const uint8_t& pin, const uint32_t& duration_us) {
+    if (!active_) return;
+    TraceRecord record;
+    record.timestamp_ms = millis();
+    record.kind = TRACE_KIND::ECHO;
+    record.pin = pin;
+    record.echo_us = duration_us;
+    append_(record);
+}
+
+void TraceRecorder::trigger() {
+    if (!active_) return;
+    TraceRecord record;
+    record.timestamp_ms = millis();
+    record.kind = TRACE_KIND::TRIGGER;
+    append_(record);
+}
+
+void TraceRecorder::delay(const uint16_t& delay_min, const uint16_t& delay_sec) {
+    if (!active_) return;
+    TraceRecord record;
+    record.timestamp_ms = millis();
+    record.kind = TRACE_KIND::DELAY;
+    record.delay_min = delay_min;
+    record.delay_sec = delay_sec;
+    append_(record);
+}
+
+void TraceRecorder::flush() {
+    if (!active_ || used_ == 0) return;
+    file_.write(buffer_, used_);
+    file_.flush();
+    used_ = 0;
+}
+
+void TraceRecorder::append_(const TraceRecord& record) {
+    if (used_ + TRACE_RECORD_MAX_SIZE > TRACE_BUFFER_SIZE) {
+        flush();
+    }
+    used_ += encodeTraceRecord(record, last_ms_, buffer_ + used_);
+}
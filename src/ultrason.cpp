@@ -1,9 +1,22 @@
 #include "ultrason.hpp"
 
-constexpr float SOUND_SPEED = 0.034;
+#include "trace.hpp"
 
-extern void printLog(const char* function, LOG_LEVEL level, const char* message,
-                     ...);
+// Poll periods: default, someone near or approaching, corridor empty and
+// stable. FAST stays above the echo timeout (~25 ms at 400 cm).
+#define ULTRASON_POLL_MS 100
+#define ULTRASON_POLL_FAST_MS 40
+#define ULTRASON_POLL_IDLE_MS 300
+// A raw reading this much closer than the filtered distance is an approach
+#define ULTRASON_APPROACH_CM 5
+// Predicted crossing: approaching faster than this, reaching min_distance_
+// within ULTRASON_PREDICT_MS at the current speed
+#define ULTRASON_MIN_APPROACH_CM_S 20
+#define ULTRASON_PREDICT_MS 1500
+// An echo started longer ago than this (no try while playing) is dropped
+#define ULTRASON_ECHO_MAX_AGE_MS (ULTRASON_POLL_IDLE_MS + 100)
+// Once within min_distance_, leaving takes min_distance_ + this
+#define ULTRASON_HYSTERESIS_CM 5
 
 Ultrason::Ultrason(const int& delayMin, const int& delaySec,
                    const uint8_t& echo_pin, const int& scenario,
@@ -14,44 +27,24 @@ Ultrason::Ultrason(const int& delayMin, const int& delaySec,
       trig_pin_(trig_pin),
       min_distance_(min_distance),
       time_within_minimum_sec_(time_within_minimum_sec),
-      time_within_minimum_sec_2_(time_within_minimum_sec2) {}
+      time_within_minimum_sec_2_(time_within_minimum_sec2),
+      echo_(trig_pin, echo_pin) {}
 
 Ultrason::~Ultrason() {}
 
-bool Ultrason::isTriggered(uint32_t& minutes_since_act,
-                           uint8_t& seconds_since_act,
-                           uint32_t seconds_since_boot_act_timestamp,
-                           const uint32_t& seconds_since_boot,
-                           PLAYER_STATE& player_state) {
-    
-    static uint32_t last_try_timestamp_ms = 0;
-    
+bool Ultrason::isTriggered(const uint64_t& now_ms, PLAYER_STATE& player_state) {
+    // Poll period, hold times and echo ages, wrap-safe like millis()
+    uint32_t now = now_ms;
     switch (scenario_) {
         case ULTRASON_SCENARIO::PLAY_ONCE_WHEN_WITHIN: {
             if (player_state == PLAYER_STATE::PLAYING) {
                 return true;
             }
-            if (millis() - last_try_timestamp_ms < 100) {
+            if (now - last_try_timestamp_ms_ < pollPeriodMs_()) {
                 return false;
             }
-            last_try_timestamp_ms = millis();
-            // Clears the trigPin
-            digitalWrite(trig_pin_, LOW);
-            delayMicroseconds(2);
-            // Sets the trigPin on HIGH state for 10 micro seconds
-            digitalWrite(trig_pin_, HIGH);
-            delayMicroseconds(10);
-            digitalWrite(trig_pin_, LOW);
-
-            // Reads the echoPin, returns the sound wave travel time in
-            // microseconds
-            uint32_t duration = pulseIn(pin_, HIGH);
-            printLog(__func__, LOG_LEVEL::LOG_INFO, "duration: %d", duration);
-            // Calculate the distance
-            float distance_cm = duration * SOUND_SPEED / 2;
-            printLog(__func__, LOG_LEVEL::LOG_INFO, "distance_cm: %f",
-                     distance_cm);
-            if (distance_cm <= min_distance_)
+            last_try_timestamp_ms_ = now;
+            if (isWithin_(now))
                 return true;
             else {
                 return false;
@@ -61,16 +54,12 @@ bool Ultrason::isTriggered(uint32_t& minutes_since_act,
 
         case ULTRASON_SCENARIO::PLAY_ONCE_WHEN_WITHIN_MORE_THAN_X_SEC_AND_AGAIN_WHEN_STILL_WITHIN_MORE_THAN_Y_SEC: {
             if (state_ == ULTRASON_STATE::INSIDE_FOR_X_SEC_AND_AGAIN_FOR_Y_SEC) {
-                static uint32_t last_sucessful_try_timestamp_ms_2 = 0;
-                return logicTriggerTimeThresholdInside_(player_state,
-                                                    last_try_timestamp_ms, last_sucessful_try_timestamp_ms_2);
+                return logicTriggerTimeThresholdInside_(now, player_state);
             }
         }
 
         case ULTRASON_SCENARIO::PLAY_ONCE_WHEN_WITHIN_MORE_THAN_X_SEC: {
-            static uint32_t last_sucessful_try_timestamp_ms = 0;
-            return logicTriggerTimeThresholdInside_(player_state,
-                                                    last_try_timestamp_ms, last_sucessful_try_timestamp_ms);
+            return logicTriggerTimeThresholdInside_(now, player_state);
             break;
         }
 
@@ -88,74 +77,148 @@ bool Ultrason::isTriggered(uint32_t& minutes_since_act,
     }
 }
 
-bool Ultrason::logicTriggerTimeThresholdInside_(PLAYER_STATE& player_state, uint32_t& last_try_timestamp_ms, uint32_t& last_sucessful_try_timestamp_ms_3) {
-    static uint32_t last_sucessful_try_timestamp_ms = 0;
-    static PLAYER_STATE last_player_state = PLAYER_STATE::STOPPED;
+bool Ultrason::logicTriggerTimeThresholdInside_(const uint32_t& now, PLAYER_STATE& player_state) {
     if (player_state == PLAYER_STATE::PLAYING) {
-        last_player_state = player_state;
+        last_player_state_ = player_state;
         return true;
-    } else if (millis() - last_try_timestamp_ms < 100) {
-        last_player_state = player_state;
+    } else if (now - last_try_timestamp_ms_ < pollPeriodMs_()) {
+        last_player_state_ = player_state;
         return false;
     }
 
-    printLog(__func__, LOG_LEVEL::LOG_INFO, "player_state: %d", player_state);
+    printLog(__func__, LOG_LEVEL::LOG_DEBUG, "player_state: %d", player_state);
 
-    last_try_timestamp_ms = millis();
-    if (measureDistance_() <= min_distance_) {
-        if (last_player_state == PLAYER_STATE::PLAYING && player_state == PLAYER_STATE::STOPPED) {
+    last_try_timestamp_ms_ = now;
+    if (isWithin_(now)) {
+        if (last_player_state_ == PLAYER_STATE::PLAYING && player_state == PLAYER_STATE::STOPPED) {
             printLog(__func__, LOG_LEVEL::LOG_INFO, "last_player_state = playing and player_state = stopped");
             if (state_ == ULTRASON_STATE::INSIDE_FOR_X_SEC) {
                 printLog(__func__, LOG_LEVEL::LOG_INFO, "state_ == ULTRASON_STATE::INSIDE_FOR_X_SEC");
                 state_ = ULTRASON_STATE::INSIDE_FOR_X_SEC_AND_AGAIN_FOR_Y_SEC;
             }
-            last_player_state = player_state;
-            last_sucessful_try_timestamp_ms = millis();
+            last_player_state_ = player_state;
+            last_sucessful_try_timestamp_ms_ = now;
             return false;
         } else if (state_ == ULTRASON_STATE::OUTSIDE) {
             state_ = ULTRASON_STATE::INSIDE_FOR_X_SEC;
         }
-        last_player_state = player_state;
-        return stayedInside_(last_sucessful_try_timestamp_ms);
+        last_player_state_ = player_state;
+        return stayedInside_(now);
     } else {
         if (state_ == ULTRASON_STATE::INSIDE_FOR_X_SEC_AND_AGAIN_FOR_Y_SEC) {
             state_ = ULTRASON_STATE::INSIDE_TO_OUTSIDE;
             return true;
         }
         state_ = ULTRASON_STATE::OUTSIDE;
-        last_sucessful_try_timestamp_ms = millis();
-        last_player_state = player_state;
+        last_sucessful_try_timestamp_ms_ = now;
+        last_player_state_ = player_state;
         return false;
     }
 }
 
-bool Ultrason::stayedInside_(uint32_t& last_sucessful_try_timestamp_ms) {
-    if (last_sucessful_try_timestamp_ms == 0) {
-        last_sucessful_try_timestamp_ms = millis();
+bool Ultrason::stayedInside_(const uint32_t& now) {
+    if (last_sucessful_try_timestamp_ms_ == 0) {
+        last_sucessful_try_timestamp_ms_ = now;
         return false;
-    } else if (((millis() - last_sucessful_try_timestamp_ms >=
-                time_within_minimum_sec_ * 1000) && (state_ == ULTRASON_STATE::INSIDE_FOR_X_SEC || state_ == ULTRASON_STATE::OUTSIDE)) || ((millis() - last_sucessful_try_timestamp_ms >= time_within_minimum_sec_2_ * 1000) && state_ == ULTRASON_STATE::INSIDE_FOR_X_SEC_AND_AGAIN_FOR_Y_SEC)) {
+    } else if (((now - last_sucessful_try_timestamp_ms_ >=
+                time_within_minimum_sec_ * 1000) && (state_ == ULTRASON_STATE::INSIDE_FOR_X_SEC || state_ == ULTRASON_STATE::OUTSIDE)) || ((now - last_sucessful_try_timestamp_ms_ >= time_within_minimum_sec_2_ * 1000) && state_ == ULTRASON_STATE::INSIDE_FOR_X_SEC_AND_AGAIN_FOR_Y_SEC)) {
         return true;
     } else {
         return false;
     }
 }
 
-uint16_t Ultrason::measureDistance_() {
-    // Clears the trigPin
-    digitalWrite(trig_pin_, LOW);
-    delayMicroseconds(2);
-    // Sets the trigPin on HIGH state for 10 micro seconds
-    digitalWrite(trig_pin_, HIGH);
-    delayMicroseconds(10);
-    digitalWrite(trig_pin_, LOW);
-
-    // Reads the echoPin, returns the sound wave travel time in microseconds
-    uint32_t duration = pulseIn(pin_, HIGH);
-    // Calculate the distance
-    float distance_cm = duration * SOUND_SPEED / 2;
-    printLog(__func__, LOG_LEVEL::LOG_INFO, "distance_cm: %f", distance_cm);
-    return distance_cm;
+// Returns the distance of the last completed echo and sends the next
+// trigger pulse: the echo then has the whole try period to come back, the
+// loop never waits for it.
+uint16_t Ultrason::measureDistance_(const uint32_t& now) {
+    if (now - echo_start_ms_ <= ULTRASON_ECHO_MAX_AGE_MS) {
+        readEcho_(now);
+    } else {
+        echo_.available();
+        filter_.reset();
+        distance_cm_ = ECHO_OUT_OF_RANGE;
+        history_count_ = 0;
+    }
+    echo_start_ms_ = now;
+    echo_.start();
+    // Without interrupt the measurement is synchronous
+    readEcho_(now);
+    return distance_cm_;
+}
+
+void Ultrason::readEcho_(const uint32_t& now) {
+    if (!echo_.available()) {
+        return;
+    }
+    uint32_t duration = echo_.read();
+    traceRecorder.echo(pin_, duration);
+    uint16_t raw_cm = EchoTimer::toCm(duration);
+    uint16_t previous_cm = distance_cm_;
+    distance_cm_ = filter_.add(duration);
+    approaching_ = raw_cm + ULTRASON_APPROACH_CM < previous_cm;
+    stable_ = distance_cm_ + ULTRASON_APPROACH_CM >= previous_cm &&
+              distance_cm_ <= previous_cm + ULTRASON_APPROACH_CM;
+    printLog(__func__, LOG_LEVEL::LOG_DEBUG, "duration: %d distance_cm: %d", duration,
+             distance_cm_);
+
+    history_[history_next_].timestamp_ms = now;
+    history_[history_next_].distance_cm = distance_cm_;
+    history_next_ = (history_next_ + 1) % ULTRASON_HISTORY_SIZE;
+    if (history_count_ < ULTRASON_HISTORY_SIZE) {
+        history_count_++;
+    }
+}
+
+// Approach speed over the history window, from the filtered distances.
+// Someone already inside with a dwell timer running counts as well.
+bool Ultrason::isApproaching(const uint64_t& now_ms) const {
+    if (scenario_ != ULTRASON_SCENARIO::PLAY_ONCE_WHEN_WITHIN &&
+        scenario_ != ULTRASON_SCENARIO::PLAY_ONCE_WHEN_WITHIN_MORE_THAN_X_SEC &&
+        scenario_ != ULTRASON_SCENARIO::PLAY_ONCE_WHEN_WITHIN_MORE_THAN_X_SEC_AND_AGAIN_WHEN_STILL_WITHIN_MORE_THAN_Y_SEC) {
+        return false;
+    }
+    if (within_) {
+        return scenario_ != ULTRASON_SCENARIO::PLAY_ONCE_WHEN_WITHIN;
+    }
+    if (history_count_ < 2) {
+        return false;
+    }
+    const Sample& newest = history_[(history_next_ + ULTRASON_HISTORY_SIZE - 1) % ULTRASON_HISTORY_SIZE];
+    const Sample& oldest = history_[(history_next_ + ULTRASON_HISTORY_SIZE - history_count_) % ULTRASON_HISTORY_SIZE];
+    uint32_t elapsed_ms = newest.timestamp_ms - oldest.timestamp_ms;
+    if (elapsed_ms == 0 || newest.distance_cm >= oldest.distance_cm ||
+        (uint32_t)now_ms - newest.timestamp_ms > ULTRASON_ECHO_MAX_AGE_MS) {
+        return false;
+    }
+    uint32_t speed_cm_s = (uint32_t)(oldest.distance_cm - newest.distance_cm) * 1000 / elapsed_ms;
+    if (speed_cm_s < ULTRASON_MIN_APPROACH_CM_S) {
+        return false;
+    }
+    uint32_t remaining_cm = newest.distance_cm > min_distance_ ? newest.distance_cm - min_distance_ : 0;
+    return remaining_cm * 1000 / speed_cm_s <= ULTRASON_PREDICT_MS;
+}
+
+// Playback needs no polling at all (isTriggered returns before), someone
+// inside only has the time_within_minimum timers to feed, an approach or a
+// reading near min_distance_ gets fast bursts, an empty corridor slows down.
+uint16_t Ultrason::pollPeriodMs_() const {
+    if (within_ && scenario_ != ULTRASON_SCENARIO::PLAY_ONCE_WHEN_WITHIN) {
+        return ULTRASON_POLL_MS;
+    }
+    if (within_ || approaching_ || distance_cm_ <= 2 * min_distance_) {
+        return ULTRASON_POLL_FAST_MS;
+    }
+    if (stable_) {
+        return ULTRASON_POLL_IDLE_MS;
+    }
+    return ULTRASON_POLL_MS;
+}
+
+bool Ultrason::isWithin_(const uint32_t& now) {
+    uint16_t distance_cm = measureDistance_(now);
+    within_ = distance_cm <= min_distance_ + (within_ ? ULTRASON_HYSTERESIS_CM : 0);
+    return within_;
 }
 
 void Ultrason::pickMusicSpecial_()
@@ -177,6 +240,29 @@ void Ultrason::pickMusicSpecial_()
     }
 }
 
+uint8_t Ultrason::nextIndex() const {
+    if (scenario_ != ULTRASON_SCENARIO::PLAY_ONCE_WHEN_WITHIN_MORE_THAN_X_SEC_AND_AGAIN_WHEN_STILL_WITHIN_MORE_THAN_Y_SEC) {
+        return Capteur::nextIndex();
+    }
+    switch (state_) {
+        case ULTRASON_STATE::INSIDE_FOR_X_SEC_AND_AGAIN_FOR_Y_SEC:
+            return 1;
+        case ULTRASON_STATE::INSIDE_TO_OUTSIDE:
+            return 2;
+        default:
+            return 0;
+    }
+}
+
+// The special scenario plays the first, second and third track of its
+// playlist for each stage, never shuffled
+uint8_t Ultrason::trackAt_(const uint8_t& index) const {
+    if (scenario_ != ULTRASON_SCENARIO::PLAY_ONCE_WHEN_WITHIN_MORE_THAN_X_SEC_AND_AGAIN_WHEN_STILL_WITHIN_MORE_THAN_Y_SEC) {
+        return Capteur::trackAt_(index);
+    }
+    return playlist_[index];
+}
+
 void Ultrason::pickMusic() {
     switch (scenario_) {
         case ULTRASON_SCENARIO::
@@ -0,0 +1,44 @@
+#include "warm.hpp"
+
+bool WarmSource::prepare(const char* path) {
+    warm_track_ = -1;
+    prepared_ = ReadAheadSource::open(path);
+    return prepared_;
+}
+
+bool WarmSource::isPrepared(const char* path) const {
+    return prepared_ && strcmp(this->path(), path) == 0;
+}
+
+bool WarmSource::open(const char* path) {
+    warm_track_ = -1;
+    if (isPrepared(path)) {
+        metrics_ = ReadAheadMetrics();
+        prepared_ = false;
+        return true;
+    }
+    prepared_ = false;
+    return ReadAheadSource::open(path);
+}
+
+uint32_t WarmSource::read(void* data, uint32_t len) {
+    prepared_ = false;
+    return ReadAheadSource::read(data, len);
+}
+
+bool WarmSource::seek(int32_t pos, int dir) {
+    prepared_ = false;
+    return ReadAheadSource::seek(pos, dir);
+}
+
+bool WarmSource::takeWarm(const uint8_t& track) {
+    bool warm = warm_track_ == track && isOpen();
+    warm_track_ = -1;
+    return warm;
+}
+
+bool WarmSource::close() {
+    warm_track_ = -1;
+    prepared_ = false;
+    return ReadAheadSource::close();
+}
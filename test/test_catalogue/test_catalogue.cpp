@@ -0,0 +1,129 @@
+#include <string>
+#include <vector>
+
+#include <unity.h>
+
+#include "catalogue.hpp"
+
+namespace {
+
+const char* PAYLOAD =
+    "{\"is_error\":false,\"delayMin\":2,\"delaySec\":30,\"delayBefSec\":5,"
+    "\"holdMs\":4000,\"releaseMs\":1500,\"debounceMs\":200,"
+    "\"data\":[{\"id\":1,\"t\":\"intro.mp3\",\"s\":12345},"
+    "{\"id\":7,\"t\":\"caf\\u00e9 \\\"live\\\".mp3\",\"s\":\"678\"}]}";
+
+std::vector<CatalogueTrack> tracks;
+
+void storeTrack(const CatalogueTrack& track, void*) {
+    tracks.push_back(track);
+}
+
+void feedAll(CatalogueParser& parser, const std::string& payload, const size_t& chunk) {
+    parser.begin(storeTrack, nullptr);
+    for (size_t i = 0; i < payload.size(); i += chunk) {
+        size_t len = payload.size() - i < chunk ? payload.size() - i : chunk;
+        parser.feed((const uint8_t*)payload.data() + i, len);
+    }
+}
+
+}  // namespace
+
+void setUp() {
+    tracks.clear();
+}
+
+void tearDown() {}
+
+void test_whole_payload() {
+    CatalogueParser parser;
+    feedAll(parser, PAYLOAD, strlen(PAYLOAD));
+    TEST_ASSERT_TRUE(parser.isValid());
+    TEST_ASSERT_EQUAL(2, parser.delayMin());
+    TEST_ASSERT_EQUAL(30, parser.delaySec());
+    TEST_ASSERT_EQUAL(5, parser.delayBefSec());
+    TEST_ASSERT_EQUAL(4000, parser.holdMs());
+    TEST_ASSERT_EQUAL(1500, parser.releaseMs());
+    TEST_ASSERT_EQUAL(200, parser.debounceMs());
+    TEST_ASSERT_EQUAL(2, tracks.size());
+    TEST_ASSERT_EQUAL(1, tracks[0].id);
+    TEST_ASSERT_EQUAL(12345, tracks[0].size);
+    TEST_ASSERT_EQUAL_STRING("intro.mp3", tracks[0].title);
+}
+
+void test_escapes_and_string_size() {
+    CatalogueParser parser;
+    feedAll(parser, PAYLOAD, strlen(PAYLOAD));
+    TEST_ASSERT_EQUAL(2, tracks.size());
+    TEST_ASSERT_EQUAL(7, tracks[1].id);
+    TEST_ASSERT_EQUAL(678, tracks[1].size);
+    TEST_ASSERT_EQUAL_STRING("caf\xC3\xA9 \"live\".mp3", tracks[1].title);
+}
+
+void test_byte_at_a_time() {
+    CatalogueParser parser;
+    feedAll(parser, PAYLOAD, 1);
+    TEST_ASSERT_TRUE(parser.isValid());
+    TEST_ASSERT_EQUAL(2, tracks.size());
+    TEST_ASSERT_EQUAL_STRING("intro.mp3", tracks[0].title);
+    TEST_ASSERT_EQUAL(30, parser.delaySec());
+}
+
+void test_is_error() {
+    CatalogueParser parser;
+    feedAll(parser, "{\"is_error\":true,\"data\":[]}", 64);
+    TEST_ASSERT_TRUE(parser.isDone());
+    TEST_ASSERT_FALSE(parser.isValid());
+}
+
+void test_truncated_payload() {
+    std::string payload(PAYLOAD);
+    CatalogueParser parser;
+    feedAll(parser, payload.substr(0, payload.size() - 20), 16);
+    TEST_ASSERT_FALSE(parser.isDone());
+    TEST_ASSERT_FALSE(parser.isValid());
+    TEST_ASSERT_FALSE(parser.hasError());
+}
+
+void test_malformed_payload() {
+    CatalogueParser parser;
+    feedAll(parser, "{\"is_error\":false}}", 64);
+    TEST_ASSERT_TRUE(parser.isDone());
+    feedAll(parser, "{\"is_error\":false,\"t\":\"\\u00zz\"}", 64);
+    TEST_ASSERT_TRUE(parser.hasError());
+    TEST_ASSERT_FALSE(parser.isValid());
+}
+
+void test_too_long_title() {
+    std::string title(CATALOGUE_VALUE_SIZE, 'a');
+    std::string payload = "{\"is_error\":false,\"data\":[{\"id\":1,\"t\":\"ok.mp3\",\"s\":1},"
+                          "{\"id\":2,\"t\":\"" + title + ".mp3\",\"s\":2}]}";
+    CatalogueParser parser;
+    feedAll(parser, payload, 32);
+    TEST_ASSERT_TRUE(parser.hasError());
+    TEST_ASSERT_FALSE(parser.isValid());
+    TEST_ASSERT_EQUAL(1, tracks.size());
+}
+
+void test_longest_title() {
+    std::string title(CATALOGUE_VALUE_SIZE - 5, 'a');
+    std::string payload = "{\"is_error\":false,\"data\":[{\"id\":1,\"t\":\"" + title + ".mp3\",\"s\":1}]}";
+    CatalogueParser parser;
+    feedAll(parser, payload, 32);
+    TEST_ASSERT_TRUE(parser.isValid());
+    TEST_ASSERT_EQUAL(1, tracks.size());
+    TEST_ASSERT_EQUAL_STRING((title + ".mp3").c_str(), tracks[0].title);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_whole_payload);
+    RUN_TEST(test_escapes_and_string_size);
+    RUN_TEST(test_byte_at_a_time);
+    RUN_TEST(test_is_error);
+    RUN_TEST(test_truncated_payload);
+    RUN_TEST(test_malformed_payload);
+    RUN_TEST(test_too_long_title);
+    RUN_TEST(test_longest_title);
+    return UNITY_END();
+}
@@ -0,0 +1,98 @@
+#include <vector>
+
+#include <unity.h>
+
+#include <SD.h>
+
+#include "download.hpp"
+
+namespace {
+
+constexpr size_t BUFFER_SIZE = DOWNLOAD_SECTOR_SIZE * DOWNLOAD_BUFFER_SECTORS;
+
+File file;
+DownloadMetrics metrics;
+SectorWriter writer;
+
+// Writes len bytes of a known pattern, in chunks of at most chunk bytes
+// read straight into tail() like the network client does
+void writePattern(const size_t& len, const size_t& chunk) {
+    size_t done = 0;
+    while (done < len) {
+        size_t n = len - done;
+        if (n > chunk) n = chunk;
+        if (n > writer.room()) n = writer.room();
+        for (size_t i = 0; i < n; i++) {
+            writer.tail()[i] = (done + i) * 7;
+        }
+        TEST_ASSERT_TRUE(writer.commit(n));
+        done += n;
+    }
+}
+
+void checkPattern(const size_t& len) {
+    File in = SD.open("/track.mp3");
+    TEST_ASSERT_EQUAL(len, in.size());
+    std::vector<uint8_t> data(len);
+    TEST_ASSERT_EQUAL(len, in.read(data.data(), len));
+    for (size_t i = 0; i < len; i++) {
+        TEST_ASSERT_EQUAL_UINT8((uint8_t)(i * 7), data[i]);
+    }
+}
+
+}  // namespace
+
+void setUp() {
+    SD.format();
+    file = SD.open("/track.mp3", FILE_WRITE);
+    metrics = DownloadMetrics();
+    writer.begin(&file, &metrics);
+}
+
+void tearDown() {
+    file.close();
+}
+
+void test_whole_buffers_only() {
+    writePattern(BUFFER_SIZE * 3 + 100, 97);
+    // Nothing written past the last full buffer before finish()
+    TEST_ASSERT_EQUAL(3, metrics.sd_writes);
+    TEST_ASSERT_EQUAL(BUFFER_SIZE * 3, file.size());
+    TEST_ASSERT_TRUE(writer.finish());
+    TEST_ASSERT_EQUAL(4, metrics.sd_writes);
+    TEST_ASSERT_EQUAL(BUFFER_SIZE * 3 + 100, metrics.bytes);
+    file.close();
+    checkPattern(BUFFER_SIZE * 3 + 100);
+}
+
+void test_exact_buffer() {
+    writePattern(BUFFER_SIZE, BUFFER_SIZE);
+    TEST_ASSERT_EQUAL(1, metrics.sd_writes);
+    TEST_ASSERT_TRUE(writer.finish());
+    TEST_ASSERT_EQUAL(1, metrics.sd_writes);
+    file.close();
+    checkPattern(BUFFER_SIZE);
+}
+
+void test_empty() {
+    TEST_ASSERT_TRUE(writer.finish());
+    TEST_ASSERT_EQUAL(0, metrics.sd_writes);
+    TEST_ASSERT_EQUAL(0, metrics.bytes);
+}
+
+void test_bytes_per_second() {
+    metrics.bytes = 50000;
+    metrics.duration_ms = 2000;
+    TEST_ASSERT_EQUAL(25000, metrics.bytesPerSecond());
+    metrics.duration_ms = 0;
+    TEST_ASSERT_EQUAL(0, metrics.bytesPerSecond());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_whole_buffers_only);
+    RUN_TEST(test_exact_buffer);
+    RUN_TEST(test_empty);
+    RUN_TEST(test_bytes_per_second);
+    return UNITY_END();
+}
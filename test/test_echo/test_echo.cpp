@@ -0,0 +1,86 @@
+#include <unity.h>
+
+#include "echo.hpp"
+
+namespace {
+
+EchoFilter filter;
+
+// Shortest round trip of an echo from cm away, as EchoTimer::read() gives it
+uint32_t echoUs(const uint16_t& cm) {
+    uint32_t echo_us = 1;
+    while (EchoTimer::toCm(echo_us) < cm) echo_us++;
+    return echo_us;
+}
+
+}  // namespace
+
+void setUp() {
+    filter.reset();
+}
+
+void tearDown() {}
+
+void test_round_trip_conversion() {
+    TEST_ASSERT_EQUAL(100, EchoTimer::toCm(echoUs(100)));
+    TEST_ASSERT_EQUAL(ECHO_OUT_OF_RANGE, EchoTimer::toCm(0));
+}
+
+void test_first_sample() {
+    TEST_ASSERT_TRUE(filter.isEmpty());
+    TEST_ASSERT_EQUAL(150, filter.add(echoUs(150)));
+    TEST_ASSERT_FALSE(filter.isEmpty());
+}
+
+void test_single_spike_dropped() {
+    filter.add(echoUs(150));
+    filter.add(echoUs(150));
+    filter.add(echoUs(150));
+    // One spurious echo, near or far, never reaches the median
+    TEST_ASSERT_EQUAL(150, filter.add(echoUs(30)));
+    TEST_ASSERT_EQUAL(150, filter.add(echoUs(150)));
+    TEST_ASSERT_EQUAL(150, filter.add(0));
+    TEST_ASSERT_EQUAL(150, filter.add(echoUs(150)));
+}
+
+void test_jitter_smoothed() {
+    for (uint8_t i = 0; i < ECHO_FILTER_SIZE; i++) {
+        filter.add(echoUs(100));
+    }
+    // A step under ECHO_FILTER_SNAP_CM goes through the EMA: a quarter at a time
+    filter.add(echoUs(108));
+    uint16_t first = filter.add(echoUs(108));
+    TEST_ASSERT_EQUAL(102, first);
+    uint16_t later = first;
+    for (uint8_t i = 0; i < 20; i++) {
+        later = filter.add(echoUs(108));
+    }
+    TEST_ASSERT_EQUAL(108, later);
+}
+
+void test_real_move_snaps() {
+    for (uint8_t i = 0; i < ECHO_FILTER_SIZE; i++) {
+        filter.add(echoUs(300));
+    }
+    filter.add(echoUs(80));
+    // As soon as the median has moved, no EMA lag
+    TEST_ASSERT_EQUAL(80, filter.add(echoUs(80)));
+}
+
+void test_out_of_range_is_max_range() {
+    filter.add(0);
+    TEST_ASSERT_EQUAL(ECHO_MAX_RANGE_CM, filter.distanceCm());
+    filter.reset();
+    TEST_ASSERT_EQUAL(ECHO_MAX_RANGE_CM, filter.add(echoUs(ECHO_MAX_RANGE_CM + 100)));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_round_trip_conversion);
+    RUN_TEST(test_first_sample);
+    RUN_TEST(test_single_spike_dropped);
+    RUN_TEST(test_jitter_smoothed);
+    RUN_TEST(test_real_move_snaps);
+    RUN_TEST(test_out_of_range_is_max_range);
+    return UNITY_END();
+}
@@ -0,0 +1,185 @@
+#include <unity.h>
+
+#include "groupe.hpp"
+
+namespace {
+
+// Votes whatever it is told to, counting the polls. With once, like the
+// Ultrason "once" scenarios, keeps the track going and then waits for the
+// visitor to leave before voting again.
+class FakeCapteur : public Capteur
+{
+public:
+    FakeCapteur() : Capteur(0, 0, 0, 0) {}
+
+    bool isTriggered(const uint64_t &, PLAYER_STATE &player_state) override {
+        polls++;
+        if (!once) {
+            return triggered;
+        }
+        if (player_state == PLAYER_STATE::PLAYING) {
+            must_leave = true;
+            return true;
+        }
+        if (!triggered) {
+            must_leave = false;
+        }
+        return triggered && !must_leave;
+    }
+
+    bool triggered = false;
+    bool once = false;
+    bool must_leave = false;
+    uint32_t polls = 0;
+};
+
+Groupe* groupe = nullptr;
+FakeCapteur* cheap[2];
+FakeCapteur* expensive;
+PLAYER_STATE player_state = PLAYER_STATE::STOPPED;
+
+// Two cheap capteurs and an expensive one, added in mixed order
+void build(const uint8_t& votes_needed, const uint16_t& window_ms) {
+    groupe = new Groupe(0, 0, votes_needed, window_ms);
+    cheap[0] = new FakeCapteur();
+    expensive = new FakeCapteur();
+    cheap[1] = new FakeCapteur();
+    TEST_ASSERT_TRUE(groupe->add(cheap[0], false));
+    TEST_ASSERT_TRUE(groupe->add(expensive, true));
+    TEST_ASSERT_TRUE(groupe->add(cheap[1], false));
+}
+
+bool poll() {
+    return groupe->isTriggered(millis(), player_state);
+}
+
+}  // namespace
+
+void setUp() {
+    shim::reset();
+    player_state = PLAYER_STATE::STOPPED;
+}
+
+void tearDown() {
+    delete groupe;
+    groupe = nullptr;
+}
+
+void test_one_vote_is_or() {
+    build(1, 0);
+    TEST_ASSERT_FALSE(poll());
+    expensive->triggered = true;
+    TEST_ASSERT_TRUE(poll());
+}
+
+void test_all_votes_is_and() {
+    build(3, 0);
+    cheap[0]->triggered = true;
+    cheap[1]->triggered = true;
+    TEST_ASSERT_FALSE(poll());
+    expensive->triggered = true;
+    TEST_ASSERT_TRUE(poll());
+}
+
+void test_expensive_polled_only_when_it_matters() {
+    build(1, 0);
+    cheap[0]->triggered = true;
+    TEST_ASSERT_TRUE(poll());
+    TEST_ASSERT_EQUAL(0, expensive->polls);
+
+    // Needs all three, the cheap ones alone already lost
+    delete groupe;
+    build(3, 0);
+    cheap[0]->triggered = true;
+    TEST_ASSERT_FALSE(poll());
+    TEST_ASSERT_EQUAL(0, expensive->polls);
+    cheap[1]->triggered = true;
+    TEST_ASSERT_FALSE(poll());
+    TEST_ASSERT_EQUAL(1, expensive->polls);
+}
+
+void test_votes_within_window() {
+    build(2, 200);
+    cheap[0]->triggered = true;
+    TEST_ASSERT_FALSE(poll());
+    cheap[0]->triggered = false;
+    shim::advanceMillis(150);
+    cheap[1]->triggered = true;
+    TEST_ASSERT_TRUE(poll());
+}
+
+void test_votes_out_of_window() {
+    build(2, 200);
+    cheap[0]->triggered = true;
+    TEST_ASSERT_FALSE(poll());
+    cheap[0]->triggered = false;
+    shim::advanceMillis(250);
+    cheap[1]->triggered = true;
+    TEST_ASSERT_FALSE(poll());
+}
+
+void test_votes_spent_on_trigger() {
+    build(2, 1000);
+    cheap[0]->triggered = true;
+    cheap[1]->triggered = true;
+    TEST_ASSERT_TRUE(poll());
+    cheap[0]->triggered = false;
+    cheap[1]->triggered = false;
+    shim::advanceMillis(10);
+    expensive->triggered = true;
+    TEST_ASSERT_FALSE(poll());
+}
+
+void test_playing_opens_no_window() {
+    build(2, 1000);
+    player_state = PLAYER_STATE::PLAYING;
+    cheap[0]->triggered = true;
+    TEST_ASSERT_FALSE(poll());
+    cheap[0]->triggered = false;
+    player_state = PLAYER_STATE::STOPPED;
+    cheap[1]->triggered = true;
+    TEST_ASSERT_FALSE(poll());
+}
+
+void test_expensive_polled_while_playing() {
+    build(1, 0);
+    expensive->once = true;
+    expensive->triggered = true;
+    TEST_ASSERT_TRUE(poll());
+
+    // The cheap vote alone keeps the track going
+    player_state = PLAYER_STATE::PLAYING;
+    cheap[0]->triggered = true;
+    uint32_t polls = expensive->polls;
+    TEST_ASSERT_TRUE(poll());
+    TEST_ASSERT_EQUAL(polls + 1, expensive->polls);
+
+    // Still there when the track ends: no trigger before leaving
+    player_state = PLAYER_STATE::STOPPED;
+    cheap[0]->triggered = false;
+    TEST_ASSERT_FALSE(poll());
+    expensive->triggered = false;
+    TEST_ASSERT_FALSE(poll());
+    expensive->triggered = true;
+    TEST_ASSERT_TRUE(poll());
+}
+
+void test_add_when_full() {
+    build(1, 0);
+    TEST_ASSERT_TRUE(groupe->add(new FakeCapteur(), false));
+    TEST_ASSERT_FALSE(groupe->add(new FakeCapteur(), false));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_one_vote_is_or);
+    RUN_TEST(test_all_votes_is_and);
+    RUN_TEST(test_expensive_polled_only_when_it_matters);
+    RUN_TEST(test_votes_within_window);
+    RUN_TEST(test_votes_out_of_window);
+    RUN_TEST(test_votes_spent_on_trigger);
+    RUN_TEST(test_playing_opens_no_window);
+    RUN_TEST(test_expensive_polled_while_playing);
+    RUN_TEST(test_add_when_full);
+    return UNITY_END();
+}
@@ -0,0 +1,124 @@
+#include <unity.h>
+
+#include "timer.hpp"
+
+namespace {
+
+constexpr uint32_t TURN_MS = TIMER_WHEEL_SLOTS << TIMER_WHEEL_TICK_SHIFT;
+
+TimerWheel* wheel = nullptr;
+uint32_t fired[2];
+
+void count(void* ctx) {
+    (*static_cast<uint32_t*>(ctx))++;
+}
+
+Timer first(count, &fired[0]);
+Timer second(count, &fired[1]);
+
+// Arms second, already due, from first's callback
+void scheduleSecond(void*) {
+    fired[0]++;
+    wheel->scheduleAt(second, 0);
+}
+
+// Every ms up to now_ms, like loop() would
+void advanceTo(const uint64_t& now_ms) {
+    for (uint64_t t = wheel->now() + 1; t <= now_ms; t++) {
+        wheel->advance(t);
+    }
+}
+
+}  // namespace
+
+void setUp() {
+    wheel = new TimerWheel();
+    fired[0] = fired[1] = 0;
+    first = Timer(count, &fired[0]);
+    second = Timer(count, &fired[1]);
+}
+
+void tearDown() {
+    delete wheel;
+    wheel = nullptr;
+}
+
+void test_one_shot_fires_at_deadline() {
+    wheel->schedule(first, 300);
+    advanceTo(299);
+    TEST_ASSERT_EQUAL(0, fired[0]);
+    advanceTo(300);
+    TEST_ASSERT_EQUAL(1, fired[0]);
+    TEST_ASSERT_FALSE(first.armed);
+    advanceTo(2000);
+    TEST_ASSERT_EQUAL(1, fired[0]);
+}
+
+void test_periodic_rearms() {
+    first.period_ms = 100;
+    wheel->schedule(first, 100);
+    advanceTo(1000);
+    TEST_ASSERT_EQUAL(10, fired[0]);
+    TEST_ASSERT_TRUE(first.armed);
+}
+
+void test_cancel() {
+    wheel->schedule(first, 100);
+    wheel->schedule(second, 100);
+    wheel->cancel(first);
+    advanceTo(500);
+    TEST_ASSERT_EQUAL(0, fired[0]);
+    TEST_ASSERT_EQUAL(1, fired[1]);
+}
+
+void test_reschedule_moves_deadline() {
+    wheel->schedule(first, 100);
+    wheel->schedule(first, 700);
+    advanceTo(699);
+    TEST_ASSERT_EQUAL(0, fired[0]);
+    advanceTo(700);
+    TEST_ASSERT_EQUAL(1, fired[0]);
+}
+
+void test_deadline_past_one_turn() {
+    // Same slot as 100 ms, three turns later
+    wheel->schedule(first, 3 * TURN_MS + 100);
+    wheel->schedule(second, 100);
+    advanceTo(3 * TURN_MS + 99);
+    TEST_ASSERT_EQUAL(0, fired[0]);
+    TEST_ASSERT_EQUAL(1, fired[1]);
+    advanceTo(3 * TURN_MS + 100);
+    TEST_ASSERT_EQUAL(1, fired[0]);
+}
+
+void test_late_advance_fires_all_due() {
+    wheel->schedule(first, 50);
+    wheel->schedule(second, 2 * TURN_MS);
+    // A loop() stalled for more than a turn
+    wheel->advance(5 * TURN_MS);
+    TEST_ASSERT_EQUAL(1, fired[0]);
+    TEST_ASSERT_EQUAL(1, fired[1]);
+}
+
+void test_armed_by_callback_fires_next_advance() {
+    first = Timer(scheduleSecond);
+    wheel->schedule(first, 10);
+    wheel->advance(10);
+    TEST_ASSERT_EQUAL(1, fired[0]);
+    TEST_ASSERT_EQUAL(0, fired[1]);
+    TEST_ASSERT_TRUE(second.armed);
+    wheel->advance(10);
+    TEST_ASSERT_EQUAL(1, fired[1]);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_one_shot_fires_at_deadline);
+    RUN_TEST(test_periodic_rearms);
+    RUN_TEST(test_cancel);
+    RUN_TEST(test_reschedule_moves_deadline);
+    RUN_TEST(test_deadline_past_one_turn);
+    RUN_TEST(test_late_advance_fires_all_due);
+    RUN_TEST(test_armed_by_callback_fires_next_advance);
+    return UNITY_END();
+}
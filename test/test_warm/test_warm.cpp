@@ -0,0 +1,86 @@
+#include <unity.h>
+
+#include <SD.h>
+
+#include "warm.hpp"
+
+namespace {
+
+WarmSource* source = nullptr;
+
+void writeTrack(const char* path, const size_t& len) {
+    File file = SD.open(path, FILE_WRITE);
+    for (size_t i = 0; i < len; i++) {
+        uint8_t byte = i;
+        file.write(&byte, 1);
+    }
+    file.close();
+}
+
+// What handleWarmUp() does: opens the track, the decoder reads its first
+// frames, then the source is told it is warm
+void warmUp(const char* path, const uint8_t& track) {
+    TEST_ASSERT_TRUE(source->open(path));
+    uint8_t frame[64];
+    TEST_ASSERT_EQUAL(sizeof(frame), source->read(frame, sizeof(frame)));
+    source->setWarm(track);
+}
+
+}  // namespace
+
+void setUp() {
+    SD.format();
+    writeTrack("/a.mp3", 4000);
+    writeTrack("/b.mp3", 4000);
+    source = new WarmSource();
+}
+
+void tearDown() {
+    delete source;
+    source = nullptr;
+}
+
+void test_trigger_plays_warm_track() {
+    warmUp("/a.mp3", 0);
+    TEST_ASSERT_EQUAL(0, source->warmTrack());
+    TEST_ASSERT_FALSE(source->takeWarm(1));
+    warmUp("/a.mp3", 0);
+    TEST_ASSERT_TRUE(source->takeWarm(0));
+    // Playing now, not warm any more
+    TEST_ASSERT_EQUAL(-1, source->warmTrack());
+    TEST_ASSERT_TRUE(source->isOpen());
+}
+
+// The sync closes the source before deleting tracks: the trigger that
+// follows must set the track up again
+void test_sync_during_warm_up() {
+    warmUp("/a.mp3", 0);
+    source->close();
+    TEST_ASSERT_TRUE(SD.remove("/a.mp3"));
+    TEST_ASSERT_EQUAL(-1, source->warmTrack());
+    TEST_ASSERT_FALSE(source->takeWarm(0));
+}
+
+void test_other_track_opened() {
+    warmUp("/a.mp3", 0);
+    TEST_ASSERT_TRUE(source->prepare("/b.mp3"));
+    TEST_ASSERT_FALSE(source->takeWarm(0));
+    warmUp("/a.mp3", 0);
+    TEST_ASSERT_TRUE(source->open("/b.mp3"));
+    TEST_ASSERT_FALSE(source->takeWarm(0));
+}
+
+void test_not_warm_when_closed() {
+    source->setWarm(0);
+    TEST_ASSERT_EQUAL(-1, source->warmTrack());
+    TEST_ASSERT_FALSE(source->takeWarm(0));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_trigger_plays_warm_track);
+    RUN_TEST(test_sync_during_warm_up);
+    RUN_TEST(test_other_track_opened);
+    RUN_TEST(test_not_warm_when_closed);
+    return UNITY_END();
+}
@@ -0,0 +1,254 @@
+#!/usr/bin/env python3
+"""Token table and decoder for the tokenized logs (-DLOG_TOKENIZED, log.hpp).
+
+As a PlatformIO extra script it writes the table of every printLog() format
+string found in src/ and include/ to $BUILD_DIR/log_tokens.csv. From the
+command line it decodes a serial capture, the "$<base64>" record lines are
+turned back into text and everything else is passed through:
+
+    pio device monitor | python3 tools/log_tokens.py
+    python3 tools/log_tokens.py capture.txt [-t .pio/build/nodemcuv2/log_tokens.csv]
+    python3 tools/log_tokens.py --write-table log_tokens.csv
+
+Without -t the table is rebuilt from the sources next to this script, which
+only matches the firmware if it was built from the same tree.
+"""
+
+import argparse
+import base64
+import binascii
+import csv
+import os
+import re
+import struct
+import sys
+
+SOURCE_DIRS = ("src", "include")
+SOURCE_EXTENSIONS = (".cpp", ".hpp", ".h")
+
+LEVELS = ("DEBUG", "INFO", "WARNING", "ERROR")
+COLORS = ("\x1b[36m", "\x1b[32m", "\x1b[33m", "\x1b[31m")
+
+# Format: adjacent literals, possibly with string macros like VERSION_CODE
+CALL = re.compile(
+    r'\bprintLog\s*\(\s*([^,]+?)\s*,\s*[\w:]+\s*,\s*'
+    r'((?:(?:"(?:[^"\\\n]|\\.)*"|\b[A-Z_][A-Z0-9_]*\b)\s*)+)')
+LITERAL = re.compile(r'"((?:[^"\\\n]|\\.)*)"|\b([A-Z_][A-Z0-9_]*)\b')
+STRING_MACRO = re.compile(r'^\s*#\s*define\s+([A-Z_][A-Z0-9_]*)\s+"((?:[^"\\\n]|\\.)*)"\s*$', re.M)
+ESCAPE = re.compile(r'\\(x[0-9a-fA-F]+|[0-7]{1,3}|.)')
+# Top-level definitions start at column 0, the name is the one __func__ gives
+DEFINITION = re.compile(r'^[A-Za-z_][^;(){}=#/]*?\b(~?\w+)\s*\([^;{}]*\)[^;{}]*\{', re.M)
+SPEC = re.compile(r'%([-+ #0]*)(\d+)?(?:\.(\d+))?(hh|h|ll|l|j|z|t|L)?([diuoxXfFeEgGaAcsp%])')
+
+SIMPLE_ESCAPES = {"n": "\n", "r": "\r", "t": "\t", "0": "\0", "a": "\a", "b": "\b",
+                  "f": "\f", "v": "\v", "\\": "\\", '"': '"', "'": "'", "?": "?"}
+
+
+def log_token(message):
+    """32-bit FNV-1a, same as logToken() in log.hpp."""
+    value = 2166136261
+    for byte in message.encode("utf-8", "surrogateescape"):
+        value = ((value ^ byte) * 16777619) & 0xFFFFFFFF
+    return value
+
+
+def unescape(literals, macros):
+    def replace(match):
+        escape = match.group(1)
+        if escape[0] == "x":
+            return chr(int(escape[1:], 16))
+        if escape[0] in "01234567":
+            return chr(int(escape, 8))
+        return SIMPLE_ESCAPES.get(escape, escape)
+
+    parts = []
+    for literal, macro in LITERAL.findall(literals):
+        parts.append(ESCAPE.sub(replace, macros.get(macro, "") if macro else literal))
+    return "".join(parts)
+
+
+def scan_sources(project_dir):
+    """Returns {token: (function, format)} for every printLog() call."""
+    sources = {}
+    for source_dir in SOURCE_DIRS:
+        for root, _, files in os.walk(os.path.join(project_dir, source_dir)):
+            for name in sorted(files):
+                if name.endswith(SOURCE_EXTENSIONS):
+                    path = os.path.join(root, name)
+                    with open(path, encoding="utf-8", errors="surrogateescape") as source:
+                        sources[path] = source.read()
+    macros = {}
+    for text in sources.values():
+        macros.update(STRING_MACRO.findall(text))
+
+    table = {}
+    for path, text in sources.items():
+        definitions = [(match.start(), match.group(1)) for match in DEFINITION.finditer(text)]
+        for call in CALL.finditer(text):
+            function = call.group(1)
+            if function == "__func__":
+                function = "?"
+                for start, definition in definitions:
+                    if start > call.start():
+                        break
+                    function = definition
+            message = unescape(call.group(2), macros)
+            token = log_token(message)
+            if token in table and table[token][1] != message:
+                sys.stderr.write("log_tokens: token 0x%08x collision in %s: %r and %r\n"
+                                 % (token, path, table[token][1], message))
+            elif token in table and function not in table[token][0].split("/"):
+                function = table[token][0] + "/" + function
+            table[token] = (function, message)
+    return table
+
+
+def write_table(table, path):
+    with open(path, "w", newline="") as out:
+        writer = csv.writer(out)
+        for token in sorted(table):
+            function, message = table[token]
+            writer.writerow(["0x%08x" % token, function, message])
+
+
+def read_table(path):
+    table = {}
+    with open(path, newline="") as table_file:
+        for row in csv.reader(table_file):
+            table[int(row[0], 16)] = (row[1], row[2])
+    return table
+
+
+class Record:
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def varint(self):
+        value = shift = 0
+        while True:
+            if self.pos >= len(self.data):
+                raise IndexError
+            byte = self.data[self.pos]
+            self.pos += 1
+            value |= (byte & 0x7F) << shift
+            shift += 7
+            if not byte & 0x80:
+                return value
+
+    def integer(self):
+        value = self.varint()
+        return (value >> 1) ^ -(value & 1)
+
+    def string(self):
+        length = self.varint()
+        if self.pos + length > len(self.data):
+            raise IndexError
+        value = self.data[self.pos:self.pos + length]
+        self.pos += length
+        return value.decode("utf-8", "replace")
+
+    def float(self):
+        if self.pos + 4 > len(self.data):
+            raise IndexError
+        value = struct.unpack_from("<f", self.data, self.pos)[0]
+        self.pos += 4
+        return value
+
+
+def format_message(message, record):
+    def replace(match):
+        flags, width, precision, length, conversion = match.groups()
+        if conversion == "%":
+            return "%"
+        spec = "%" + flags + (width or "") + ("." + precision if precision else "")
+        try:
+            if conversion == "s":
+                return (spec + "s") % record.string()
+            if conversion in "fFeEgGaA":
+                return (spec + conversion.replace("a", "e").replace("A", "E")) % record.float()
+            value = record.integer()
+        except IndexError:
+            return "<?>"
+        if conversion in "di":
+            return (spec + "d") % value
+        if conversion == "c":
+            return (spec + "c") % (value & 0xFF)
+        if value < 0:
+            value &= 0xFFFFFFFFFFFFFFFF if length in ("ll", "j") else 0xFFFFFFFF
+        if conversion == "p":
+            return (spec + "#x") % value
+        return (spec + ("d" if conversion == "u" else conversion)) % value
+
+    return SPEC.sub(replace, message)
+
+
+def decode_line(encoded, table, color):
+    try:
+        data = base64.b64decode(encoded, validate=True)
+    except (binascii.Error, ValueError):
+        return None
+    if len(data) < 6:
+        return None
+    token, level = struct.unpack_from("<IB", data)
+    record = Record(data)
+    record.pos = 5
+    try:
+        millis = record.varint()
+    except IndexError:
+        return None
+    level = min(level, len(LEVELS) - 1)
+    if token in table:
+        function, message = table[token]
+        text = format_message(message, record)
+    else:
+        function = "?"
+        text = "unknown token 0x%08x %s" % (token, data[record.pos:].hex())
+    prefix, suffix = (COLORS[level], "\x1b[0m") if color else ("", "")
+    return "%10.3f %s[%s] %s : %s%s" % (millis / 1000.0, prefix, LEVELS[level], function,
+                                        text.rstrip("\r\n"), suffix)
+
+
+def main():
+    project_dir = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("capture", nargs="?", help="serial capture, stdin when omitted")
+    parser.add_argument("-t", "--table", help="token table written by the build")
+    parser.add_argument("--write-table", metavar="PATH", help="write the table and exit")
+    parser.add_argument("--color", choices=("auto", "always", "never"), default="auto")
+    args = parser.parse_args()
+
+    if args.write_table:
+        write_table(scan_sources(project_dir), args.write_table)
+        return 0
+    table = read_table(args.table) if args.table else scan_sources(project_dir)
+    color = args.color == "always" or (args.color == "auto" and sys.stdout.isatty())
+
+    capture = open(args.capture, "rb") if args.capture else sys.stdin.buffer
+    record_line = re.compile(rb"\$([A-Za-z0-9+/]+=*)\r?$")
+    for raw in capture:
+        raw = raw.rstrip(b"\n")
+        match = record_line.search(raw)
+        decoded = decode_line(match.group(1), table, color) if match else None
+        if decoded is None:
+            sys.stdout.write(raw.rstrip(b"\r").decode("utf-8", "replace") + "\n")
+            continue
+        # Whatever the UART printed just before the record on the same line
+        before = raw[:match.start()].decode("utf-8", "replace")
+        if before:
+            sys.stdout.write(before + "\n")
+        sys.stdout.write(decoded + "\n")
+        sys.stdout.flush()
+    return 0
+
+
+try:
+    Import("env")  # noqa: F821, defined when run as a PlatformIO extra script
+except NameError:
+    env = None
+
+if env is not None:
+    os.makedirs(env.subst("$BUILD_DIR"), exist_ok=True)
+    write_table(scan_sources(env.subst("$PROJECT_DIR")), env.subst("$BUILD_DIR/log_tokens.csv"))
+elif __name__ == "__main__":
+    sys.exit(main())